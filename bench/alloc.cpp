@@ -0,0 +1,65 @@
+#include "bench.h"
+
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+// every heap allocation of the process goes through here, worker threads
+// included, so that benchmarks can count them
+
+namespace {
+
+std::atomic<uint64_t> alloc_count(0);
+std::atomic<uint64_t> alloc_bytes(0);
+
+}
+
+void*
+operator new(size_t size)
+{
+    alloc_count.fetch_add(1, std::memory_order_relaxed);
+    alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+    void* p = malloc(size > 0 ? size : 1);
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+}
+
+void*
+operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void
+operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void
+operator delete[](void* p) noexcept
+{
+    free(p);
+}
+
+void
+operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+void
+operator delete[](void* p, size_t) noexcept
+{
+    free(p);
+}
+
+namespace bench {
+
+Allocations
+allocations()
+{
+    return Allocations{alloc_count.load(std::memory_order_relaxed), alloc_bytes.load(std::memory_order_relaxed)};
+}
+
+}
@@ -0,0 +1,65 @@
+#include "bench.h"
+
+#include <iostream>
+#include <iomanip>
+#include <stdlib.h>
+#include "state.h"
+#include "base64/base64.h"
+#include "base64/base64_simd.h"
+
+namespace bench {
+
+namespace {
+
+void
+report(const char* name, double secs, size_t bytes)
+{
+    std::cout << "  " << std::setw(8) << name << ": "
+              << std::fixed << std::setprecision(1) << std::setw(8) << secs * 1e6 << " us, "
+              << std::setw(7) << bytes / secs / (1 << 20) << " MB/s" << std::endl;
+}
+
+}
+
+/** usage: base64 [grid side...], defaults to a range of realistic map sizes */
+int
+base64_main(int argc, char** argv)
+{
+    std::vector<int> sides;
+    for (int i = 1; i < argc; ++i) sides.push_back(atoi(argv[i]));
+    if (sides.empty()) sides = {32, 100, 224};
+
+    const base64::Isa isas[] = {base64::Isa::SCALAR, base64::Isa::SSE41, base64::Isa::AVX2};
+    std::cout << "best isa: " << base64::isa_name(base64::detect_isa()) << std::endl;
+    for (int side: sides) {
+        auto setup = grid_setup(side, side, side / 4 + 1, 2);
+        State state(setup);
+        state.init_execution_plan();
+        std::string encoded = state.serialize();
+        std::vector<char> raw;
+        base64::decode(encoded, &raw);
+        std::cout << side << "x" << side << " grid, " << state.num_edges() << " rivers, "
+                  << raw.size() << " state bytes" << std::endl;
+
+        std::cout << " encode" << std::endl;
+        std::string out;
+        report("legacy", time_it([&]() { Base64::Encode(raw, &out); }), raw.size());
+        for (auto isa: isas) {
+            if (isa > base64::detect_isa()) continue;
+            report(base64::isa_name(isa), time_it([&]() { base64::encode(raw.data(), raw.size(), &out, isa); }), raw.size());
+            if (out != encoded) std::cout << "  MISMATCH" << std::endl;
+        }
+
+        std::cout << " decode" << std::endl;
+        std::vector<char> back;
+        report("legacy", time_it([&]() { Base64::Decode(encoded, &back); }), raw.size());
+        for (auto isa: isas) {
+            if (isa > base64::detect_isa()) continue;
+            report(base64::isa_name(isa), time_it([&]() { base64::decode(encoded.data(), encoded.size(), &back, isa); }), raw.size());
+            if (back != raw) std::cout << "  MISMATCH" << std::endl;
+        }
+    }
+    return 0;
+}
+
+}
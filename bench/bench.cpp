@@ -0,0 +1,57 @@
+#include "bench.h"
+
+#include <iostream>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+namespace bench {
+
+double
+time_it(const std::function<void()>& fn, double min_seconds)
+{
+    fn(); // warm up
+    size_t runs = 0;
+    auto start = Clock::now();
+    double elapsed = 0;
+    do {
+        fn();
+        ++runs;
+        elapsed = seconds_since(start);
+    } while (elapsed < min_seconds);
+    return elapsed / runs;
+}
+
+Isolated
+run_isolated(const std::function<double()>& fn)
+{
+    int fds[2];
+    if (pipe(fds) != 0) abort();
+    std::cout << std::flush;
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        Allocations before = allocations();
+        Isolated r = {0, 0, 0, 0};
+        r.seconds = fn();
+        Allocations after = allocations();
+        r.allocs = after.count - before.count;
+        r.alloc_bytes = after.bytes - before.bytes;
+        ssize_t n = write(fds[1], &r, sizeof(r));
+        _exit(n == sizeof(r) ? 0 : 1);
+    }
+    close(fds[1]);
+    Isolated result = {0, 0, 0, 0};
+    if (read(fds[0], &result, sizeof(result)) != sizeof(result)) {
+        std::cerr << "benchmark child failed" << std::endl;
+    }
+    close(fds[0]);
+    int status = 0;
+    struct rusage usage;
+    wait4(pid, &status, 0, &usage);
+    result.peak_rss_kb = usage.ru_maxrss;
+    return result;
+}
+
+}
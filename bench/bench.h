@@ -0,0 +1,95 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <stdint.h>
+#include "protocol.h"
+
+namespace bench {
+
+typedef std::chrono::high_resolution_clock Clock;
+
+inline double
+seconds_since(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/** run fn repeatedly for at least min_seconds, return mean seconds per call */
+double time_it(const std::function<void()>& fn, double min_seconds = 0.2);
+
+/** w x h grid map with mines spread pseudo-randomly */
+proto::Setup grid_setup(int w, int h, int mines, int punters, uint32_t seed = 42);
+
+/**
+ * Random geometric map: sites spread over the unit square, rivers between
+ * sites closer than the radius giving `degree` rivers per site on average.
+ */
+proto::Setup geometric_setup(int sites, double degree, int mines, int punters, uint32_t seed = 42);
+
+/**
+ * Scale-free map by preferential attachment: each new site gets `links`
+ * rivers to distinct older sites picked in proportion to their degree.
+ */
+proto::Setup scale_free_setup(int sites, int links, int mines, int punters, uint32_t seed = 42);
+
+/** sites in a single line, the longest paths a map of this size can have */
+proto::Setup chain_setup(int sites, int mines, int punters, uint32_t seed = 42);
+
+/** add distinct pseudo-random mines up to `mines` */
+void pick_mines(proto::Setup* setup, int mines, uint32_t seed = 42);
+
+/** setup message text for setup, as the server would send it */
+std::string setup_json(const proto::Setup& setup);
+
+/**
+ * Silences State logging on std::cerr while in scope, or until release()
+ * for benchmarks that go on to code worth hearing from.
+ */
+class QuietState {
+public:
+    QuietState() { std::cerr.setstate(std::ios::failbit); }
+    ~QuietState() { release(); }
+
+    QuietState(const QuietState&) = delete;
+    QuietState& operator=(const QuietState&) = delete;
+
+    void release() { std::cerr.clear(); }
+};
+
+struct Isolated {
+    double seconds;   // as returned by fn
+    long peak_rss_kb;
+    uint64_t allocs;  // heap allocations made by fn
+    uint64_t alloc_bytes;
+};
+
+/**
+ * Run fn in a forked child so that peak RSS and allocations of different
+ * code paths are measured independently. fn returns the time it wants
+ * reported.
+ */
+Isolated run_isolated(const std::function<double()>& fn);
+
+/** heap allocations since the process started, all threads */
+struct Allocations {
+    uint64_t count;
+    uint64_t bytes;
+};
+
+Allocations allocations();
+
+// benchmarks, argv[0] is the benchmark name
+int base64_main(int argc, char** argv);
+int setup_main(int argc, char** argv);
+int moves_main(int argc, char** argv);
+int score_main(int argc, char** argv);
+int rollout_main(int argc, char** argv);
+int paths_main(int argc, char** argv);
+int replay_main(int argc, char** argv);
+int update_main(int argc, char** argv);
+int online_main(int argc, char** argv);
+
+}
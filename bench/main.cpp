@@ -0,0 +1,50 @@
+#include <iostream>
+#include <string.h>
+#include "bench.h"
+
+namespace {
+
+struct Command {
+    const char* name;
+    const char* help;
+    int (*run)(int argc, char** argv);
+};
+
+const Command kCommands[] = {
+    {"base64", "state blob encode/decode throughput per instruction set", bench::base64_main},
+    {"setup", "setup message to State: picojson tree vs streaming scan", bench::setup_main},
+    {"moves", "make_move latency while playing against a random opponent", bench::moves_main},
+    {"score", "incremental score of every punter vs naive recomputation", bench::score_main},
+    {"rollout", "Monte Carlo playouts per second, one thread vs all", bench::rollout_main},
+    {"paths", "shortest path search: one-way vs bidirectional BFS", bench::paths_main},
+    {"replay", "recorded game through the offline code path, latency and allocations per phase", bench::replay_main},
+    {"update", "find_edge and State::update over large move messages, hubs vs grid", bench::update_main},
+    {"online", "punters against a loopback stand-in for the server, every move checked", bench::online_main},
+};
+
+void
+usage()
+{
+    std::cerr << "usage: punter_bench <benchmark> [args]" << std::endl;
+    for (const auto& c: kCommands) {
+        std::cerr << "  " << c.name << ": " << c.help << std::endl;
+    }
+}
+
+}
+
+int
+main(int argc, char** argv)
+{
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+    for (const auto& c: kCommands) {
+        if (strcmp(argv[1], c.name) == 0) {
+            return c.run(argc - 1, argv + 1);
+        }
+    }
+    usage();
+    return 1;
+}
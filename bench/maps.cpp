@@ -0,0 +1,167 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace bench {
+
+namespace {
+
+/** sites 0..sites-1 and no rivers, futures and options on */
+proto::Setup
+empty_setup(int sites, int punters)
+{
+    proto::Setup setup;
+    setup.punter = 0;
+    setup.punters = punters;
+    setup.has_futures = true;
+    setup.has_splurges = false;
+    setup.has_options = true;
+    setup.map.sites.reserve(sites);
+    for (int i = 0; i < sites; ++i) {
+        setup.map.sites.push_back({i});
+    }
+    return setup;
+}
+
+}
+
+proto::Setup
+grid_setup(int w, int h, int mines, int punters, uint32_t seed)
+{
+    proto::Setup setup = empty_setup(w * h, punters);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            int n = y * w + x;
+            if (x + 1 < w) setup.map.rivers.push_back({n, n + 1});
+            if (y + 1 < h) setup.map.rivers.push_back({n, n + w});
+        }
+    }
+    pick_mines(&setup, mines, seed);
+    return setup;
+}
+
+proto::Setup
+geometric_setup(int sites, double degree, int mines, int punters, uint32_t seed)
+{
+    proto::Setup setup = empty_setup(sites, punters);
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> coord(0, 1);
+    std::vector<double> x(sites), y(sites);
+    for (int i = 0; i < sites; ++i) {
+        x[i] = coord(rng);
+        y[i] = coord(rng);
+    }
+    // expected degree is sites * pi * r^2; bucket points into r x r cells
+    double r = sqrt(degree / (M_PI * sites));
+    int cells = std::max(1, static_cast<int>(1 / r));
+    std::vector<std::vector<int>> bucket(cells * cells);
+    auto cell = [&](double v) { return std::min(cells - 1, static_cast<int>(v * cells)); };
+    for (int i = 0; i < sites; ++i) {
+        bucket[cell(y[i]) * cells + cell(x[i])].push_back(i);
+    }
+    for (int i = 0; i < sites; ++i) {
+        int cx = cell(x[i]), cy = cell(y[i]);
+        for (int ny = std::max(0, cy - 1); ny <= std::min(cells - 1, cy + 1); ++ny) {
+            for (int nx = std::max(0, cx - 1); nx <= std::min(cells - 1, cx + 1); ++nx) {
+                for (int j: bucket[ny * cells + nx]) {
+                    double dx = x[i] - x[j], dy = y[i] - y[j];
+                    if (j > i && dx * dx + dy * dy <= r * r) setup.map.rivers.push_back({i, j});
+                }
+            }
+        }
+    }
+    pick_mines(&setup, mines, seed);
+    return setup;
+}
+
+proto::Setup
+scale_free_setup(int sites, int links, int mines, int punters, uint32_t seed)
+{
+    proto::Setup setup = empty_setup(sites, punters);
+    links = std::max(1, std::min(links, sites - 1));
+    // every river end once in here, so a uniform pick from it is a pick
+    // of a site in proportion to its degree; starts as a star
+    std::vector<int> ends;
+    ends.reserve(2 * static_cast<size_t>(sites) * links);
+    for (int i = 1; i <= links && i < sites; ++i) {
+        setup.map.rivers.push_back({0, i});
+        ends.push_back(0);
+        ends.push_back(i);
+    }
+    std::mt19937 rng(seed);
+    std::vector<int> picked;
+    for (int i = links + 1; i < sites; ++i) {
+        picked.clear();
+        while (static_cast<int>(picked.size()) < links) {
+            int t = ends[rng() % ends.size()];
+            if (std::find(picked.begin(), picked.end(), t) == picked.end()) picked.push_back(t);
+        }
+        for (int t: picked) {
+            setup.map.rivers.push_back({t, i});
+            ends.push_back(t);
+            ends.push_back(i);
+        }
+    }
+    pick_mines(&setup, mines, seed);
+    return setup;
+}
+
+proto::Setup
+chain_setup(int sites, int mines, int punters, uint32_t seed)
+{
+    proto::Setup setup = empty_setup(sites, punters);
+    for (int i = 0; i + 1 < sites; ++i) setup.map.rivers.push_back({i, i + 1});
+    pick_mines(&setup, mines, seed);
+    return setup;
+}
+
+void
+pick_mines(proto::Setup* setup, int mines, uint32_t seed)
+{
+    mines = std::min(mines, static_cast<int>(setup->map.sites.size()));
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> site(0, setup->map.sites.size() - 1);
+    while (static_cast<int>(setup->map.mines.size()) < mines) {
+        int m = site(rng);
+        bool dup = false;
+        for (int e: setup->map.mines) dup = dup || e == m;
+        if (!dup) setup->map.mines.push_back(m);
+    }
+}
+
+std::string
+setup_json(const proto::Setup& setup)
+{
+    std::string out;
+    out.reserve(64 + 16 * setup.map.sites.size() + 32 * setup.map.rivers.size());
+    out += "{\"punter\":" + std::to_string(setup.punter);
+    out += ",\"punters\":" + std::to_string(setup.punters);
+    out += ",\"map\":{\"sites\":[";
+    for (size_t i = 0; i < setup.map.sites.size(); ++i) {
+        if (i > 0) out += ',';
+        out += "{\"id\":" + std::to_string(setup.map.sites[i].id) + "}";
+    }
+    out += "],\"rivers\":[";
+    for (size_t i = 0; i < setup.map.rivers.size(); ++i) {
+        if (i > 0) out += ',';
+        out += "{\"source\":" + std::to_string(setup.map.rivers[i].source)
+            + ",\"target\":" + std::to_string(setup.map.rivers[i].target) + "}";
+    }
+    out += "],\"mines\":[";
+    for (size_t i = 0; i < setup.map.mines.size(); ++i) {
+        if (i > 0) out += ',';
+        out += std::to_string(setup.map.mines[i]);
+    }
+    out += "]},\"settings\":{\"futures\":";
+    out += setup.has_futures ? "true" : "false";
+    out += ",\"splurges\":";
+    out += setup.has_splurges ? "true" : "false";
+    out += ",\"options\":";
+    out += setup.has_options ? "true" : "false";
+    out += "}}";
+    return out;
+}
+
+}
@@ -0,0 +1,69 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <stdlib.h>
+#include "state.h"
+#include "game.h"
+
+namespace bench {
+
+/**
+ * usage: moves [grid side] [moves] [budget ms]
+ * Plays us against one random opponent in memory and reports make_move
+ * latency percentiles. Moves are unlimited in time without a budget.
+ */
+int
+moves_main(int argc, char** argv)
+{
+    int side = argc > 1 ? atoi(argv[1]) : 250;
+    int turns = argc > 2 ? atoi(argv[2]) : 200;
+    double budget = argc > 3 ? atof(argv[3]) / 1e3 : 0;
+
+    auto setup = grid_setup(side, side, side / 4 + 1, 2);
+    QuietState quiet;
+    auto start = Clock::now();
+    State state(setup);
+    state.init_execution_plan();
+    double setup_secs = seconds_since(start);
+
+    std::mt19937 rng(7);
+    std::vector<double> lat;
+    for (int turn = 0; turn < turns && state.moves_left() > 0; ++turn) {
+        proto::Move move;
+        start = Clock::now();
+        if (budget > 0) {
+            Deadline deadline(Deadline::Clock::now(), budget);
+            make_move(&state, &move, &deadline);
+        } else {
+            make_move(&state, &move);
+        }
+        lat.push_back(seconds_since(start));
+
+        proto::Moves moves = {move};
+        // opponent claims a random free river
+        for (int tries = 0; tries < 100; ++tries) {
+            Edge* e = state.get_edge(rng() % state.num_edges());
+            proto::Move claim = state.claim_edge(e->source, e->target, 1);
+            if (e->is_unclaimed() && !(move.source == claim.source && move.target == claim.target)) {
+                moves.push_back(claim);
+                break;
+            }
+        }
+        state.update(moves);
+    }
+
+    std::sort(lat.begin(), lat.end());
+    auto pct = [&](double p) { return lat[std::min(lat.size() - 1, static_cast<size_t>(p * lat.size()))] * 1e3; };
+    std::cout << side << "x" << side << " grid, " << state.num_nodes() << " nodes, "
+              << state.num_edges() << " rivers, " << state.num_mines() << " mines" << std::endl
+              << std::fixed << std::setprecision(3)
+              << "  setup + plan: " << setup_secs * 1e3 << " ms" << std::endl
+              << "  make_move over " << lat.size() << " moves: p50 " << pct(0.5) << " ms, p90 "
+              << pct(0.9) << " ms, max " << lat.back() * 1e3 << " ms" << std::endl;
+    return 0;
+}
+
+}
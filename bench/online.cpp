@@ -0,0 +1,279 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include "picojson/picojson.h"
+
+namespace bench {
+
+namespace {
+
+/** one punter process on the other end of a loopback connection */
+struct Conn {
+    int fd = -1;
+    FILE* in = nullptr;
+};
+
+bool
+send_msg(const Conn& c, const std::string& msg)
+{
+    std::string out = std::to_string(msg.size()) + ":" + msg;
+    for (size_t done = 0; done < out.size();) {
+        ssize_t n = write(c.fd, out.data() + done, out.size() - done);
+        if (n <= 0) return false;
+        done += n;
+    }
+    return true;
+}
+
+bool
+receive_msg(const Conn& c, std::string* msg)
+{
+    size_t size = 0;
+    int ch;
+    while ((ch = fgetc(c.in)) != ':') {
+        if (ch < '0' || ch > '9') return false;
+        size = size * 10 + (ch - '0');
+    }
+    msg->resize(size);
+    return size == 0 || fread(&(*msg)[0], 1, size, c.in) == size;
+}
+
+/** the binary next to us, where the build puts it */
+std::string
+default_binary()
+{
+    char buf[4096];
+    ssize_t n = readlink("/proc/self/exe", buf, sizeof(buf) - 1);
+    if (n <= 0) return "./punter";
+    std::string path(buf, n);
+    return path.substr(0, path.rfind('/') + 1) + "punter";
+}
+
+/** what the server knows of the game, to tell legal moves */
+struct Referee {
+    explicit Referee(const proto::Setup& setup, int punters):
+        owner(setup.map.rivers.size(), -1), optioned(setup.map.rivers.size(), -1),
+        options(punters, setup.map.mines.size()), credit(punters, 0) {
+        for (size_t idx = 0; idx < setup.map.rivers.size(); ++idx) {
+            const auto& r = setup.map.rivers[idx];
+            river[key(r.source, r.target)] = idx;
+        }
+    }
+
+    static std::pair<int, int> key(int a, int b) { return std::make_pair(std::min(a, b), std::max(a, b)); }
+
+    /** river index of source-target, -1 if there is none */
+    int find(int source, int target) const {
+        auto it = river.find(key(source, target));
+        return it == river.end() ? -1 : it->second;
+    }
+
+    /**
+     * Apply the reply of punter p, parsed into moves; splurges come as a
+     * series of claims. False and nothing applied if it is not legal.
+     */
+    bool apply(int p, const proto::Moves& moves) {
+        if (moves.size() != 1 && (moves.empty() || !splurges_seen(p, moves))) return false;
+        for (const auto& m: moves) {
+            if (m.punter != p) return false;
+        }
+        const proto::Move& m = moves.front();
+        if (m.move_type == proto::PASS) {
+            credit[p]++;
+            ++passes;
+            return true;
+        }
+        std::vector<int> ids;
+        for (const auto& c: moves) {
+            int id = find(c.source, c.target);
+            if (id < 0 || std::find(ids.begin(), ids.end(), id) != ids.end()) return false;
+            ids.push_back(id);
+            if (c.move_type == proto::CLAIM && owner[id] >= 0) return false;
+            if (c.move_type == proto::OPTION && (owner[id] < 0 || owner[id] == p || optioned[id] >= 0
+                                                 || options[p] == 0)) return false;
+        }
+        for (int id: ids) {
+            if (m.move_type == proto::CLAIM) owner[id] = p;
+            else optioned[id] = p;
+        }
+        if (m.move_type == proto::OPTION) {
+            options[p]--;
+            ++option_moves;
+        } else if (moves.size() > 1) {
+            credit[p] -= moves.size() - 1;
+            ++splurge_moves;
+        } else {
+            ++claims;
+        }
+        return true;
+    }
+
+    /** a route of connected claims the punter has passed long enough for */
+    bool splurges_seen(int p, const proto::Moves& moves) const {
+        for (size_t idx = 0; idx < moves.size(); ++idx) {
+            if (moves[idx].move_type != proto::CLAIM) return false;
+            if (idx > 0 && moves[idx].source != moves[idx - 1].target) return false;
+        }
+        return moves.size() - 1 <= static_cast<size_t>(credit[p]);
+    }
+
+    std::map<std::pair<int, int>, int> river;
+    std::vector<int> owner, optioned; // punter per river, -1 for nobody
+    std::vector<uint32_t> options;    // left per punter
+    std::vector<int> credit;          // passes banked per punter
+    int claims = 0, option_moves = 0, splurge_moves = 0, passes = 0;
+};
+
+}
+
+/**
+ * usage: online [punter binary] [grid side] [punters]
+ * Stands in for the game server over loopback: starts the punters with
+ * --online, plays a whole game on a grid with futures, splurges and
+ * options on, checks that every move is legal and that every punter exits
+ * cleanly. Reports reply latency as the server sees it.
+ */
+int
+online_main(int argc, char** argv)
+{
+    std::string binary = argc > 1 ? argv[1] : default_binary();
+    int side = argc > 2 ? atoi(argv[2]) : 8;
+    int punters = argc > 3 ? atoi(argv[3]) : 3;
+
+    proto::Setup setup = grid_setup(side, side, std::max(2, side / 3), punters);
+    setup.has_futures = setup.has_splurges = setup.has_options = true;
+
+    int srv = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (srv < 0 || bind(srv, reinterpret_cast<sockaddr*>(&addr), len) != 0 || listen(srv, punters) != 0
+        || getsockname(srv, reinterpret_cast<sockaddr*>(&addr), &len) != 0) {
+        std::cerr << "cannot listen on loopback: " << strerror(errno) << std::endl;
+        return 1;
+    }
+    std::string port = std::to_string(ntohs(addr.sin_port));
+    // a punter that died or hangs fails the run instead of blocking it
+    struct timeval timeout = {10, 0};
+    setsockopt(srv, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    std::cout << std::flush;
+    // processes connect in any order, the order of accepting makes the ids
+    std::vector<pid_t> pids(punters);
+    for (pid_t& pid: pids) {
+        pid = fork();
+        if (pid == 0) {
+            close(srv);
+            int null = open("/dev/null", O_WRONLY);
+            dup2(null, 2);
+            execl(binary.c_str(), binary.c_str(), "--online", "127.0.0.1", port.c_str(), static_cast<char*>(nullptr));
+            _exit(127);
+        }
+    }
+    int errors = 0;
+    auto fail = [&](int p, const std::string& what) {
+        if (errors++ < 10) std::cerr << "punter " << p << ": " << what << std::endl;
+    };
+
+    std::string msg;
+    std::vector<Conn> conns(punters);
+    for (int p = 0; p < punters; ++p) {
+        Conn& c = conns[p];
+        c.fd = accept(srv, nullptr, nullptr);
+        if (c.fd >= 0) setsockopt(c.fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        c.in = c.fd >= 0 ? fdopen(c.fd, "r") : nullptr;
+        picojson::value jsn;
+        if (c.in == nullptr || !receive_msg(c, &msg) || !picojson::parse(jsn, msg).empty()
+            || !jsn.contains("me")) {
+            std::cerr << "no handshake from punter " << p << std::endl;
+            for (pid_t pid: pids) kill(pid, SIGKILL);
+            return 1;
+        }
+        send_msg(c, "{\"you\":" + jsn.get("me").serialize() + "}");
+    }
+    close(srv);
+
+    for (int p = 0; p < punters; ++p) {
+        setup.punter = p;
+        picojson::value jsn;
+        if (!send_msg(conns[p], setup_json(setup)) || !receive_msg(conns[p], &msg)
+            || !picojson::parse(jsn, msg).empty() || !jsn.contains("ready")) {
+            fail(p, "no ready message");
+            continue;
+        }
+        if (jsn.contains("state")) fail(p, "sent its state in online mode");
+    }
+
+    Referee referee(setup, punters);
+    std::vector<std::string> last(punters);
+    for (int p = 0; p < punters; ++p) last[p] = "{\"pass\":{\"punter\":" + std::to_string(p) + "}}";
+    std::vector<double> lat;
+    for (size_t turn = 0; turn < setup.map.rivers.size() && errors == 0; ++turn) {
+        int p = turn % punters;
+        std::string moves;
+        for (int q = 0; q < punters; ++q) moves += (q > 0 ? "," : "") + last[(p + q) % punters];
+        auto start = Clock::now();
+        if (!send_msg(conns[p], "{\"move\":{\"moves\":[" + moves + "]}}") || !receive_msg(conns[p], &msg)) {
+            fail(p, "connection lost");
+            break;
+        }
+        lat.push_back(seconds_since(start));
+
+        // parse the reply the way move lists are parsed
+        std::string wrapped = "{\"move\":{\"moves\":[" + msg + "]}}";
+        proto::Moves reply;
+        proto::Slice state;
+        proto::read_moves(&wrapped, &reply, &state);
+        if (state.data != nullptr) fail(p, "sent its state in online mode");
+        if (!referee.apply(p, reply)) fail(p, "illegal move " + msg);
+        last[p] = msg;
+    }
+
+    std::string scores;
+    for (int p = 0; p < punters; ++p) scores += (p > 0 ? "," : "") + std::string("{\"punter\":")
+                                                + std::to_string(p) + ",\"score\":0}";
+    std::string moves;
+    for (int p = 0; p < punters; ++p) moves += (p > 0 ? "," : "") + last[p];
+    for (int p = 0; p < punters; ++p) {
+        send_msg(conns[p], "{\"stop\":{\"moves\":[" + moves + "],\"scores\":[" + scores + "]}}");
+        fclose(conns[p].in);
+    }
+    std::vector<int> codes;
+    for (pid_t pid: pids) {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        codes.push_back(WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+        if (codes.back() != 0) fail(-1, "process exit status " + std::to_string(codes.back()));
+    }
+
+    std::sort(lat.begin(), lat.end());
+    std::cout << side << "x" << side << " grid, " << punters << " punters, " << lat.size() << " moves: "
+              << referee.claims << " claims, " << referee.option_moves << " options, "
+              << referee.splurge_moves << " splurges, " << referee.passes << " passes" << std::endl;
+    if (!lat.empty()) {
+        std::cout << std::fixed << std::setprecision(3) << "  reply p50 " << lat[lat.size() / 2] * 1e3
+                  << " ms, max " << lat.back() * 1e3 << " ms" << std::endl;
+    }
+    std::cout << "  exit codes:";
+    for (int code: codes) std::cout << " " << code;
+    std::cout << std::endl << "errors: " << errors << std::endl;
+    return errors == 0 ? 0 : 1;
+}
+
+}
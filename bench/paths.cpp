@@ -0,0 +1,107 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <stdlib.h>
+#include "state.h"
+#include "game.h"
+
+namespace bench {
+
+namespace {
+
+typedef bool (*PathFn)(State*, uint32_t, uint32_t, bool, Deadline*, std::vector<Edge*>*, unsigned, size_t*);
+
+struct Run {
+    std::vector<double> lat;
+    double visited = 0;
+    std::vector<size_t> lengths; // 0 when not found
+};
+
+Run
+run(State* state, PathFn fn, const std::vector<std::pair<uint32_t, uint32_t>>& pairs)
+{
+    Run r;
+    Deadline unlimited;
+    std::vector<Edge*> path;
+    for (const auto& p: pairs) {
+        size_t visited = 0;
+        auto start = Clock::now();
+        bool found = fn(state, p.first, p.second, false, &unlimited, &path, 0, &visited);
+        r.lat.push_back(seconds_since(start));
+        r.visited += visited;
+        r.lengths.push_back(found ? path.size() : 0);
+    }
+    std::sort(r.lat.begin(), r.lat.end());
+    r.visited /= pairs.size();
+    return r;
+}
+
+void
+report(const char* name, const Run& r)
+{
+    double mean = 0;
+    for (double l: r.lat) mean += l;
+    mean /= r.lat.size();
+    std::cout << "  " << std::setw(6) << name << ": " << std::fixed << std::setprecision(0)
+              << std::setw(9) << r.visited << " nodes visited, " << std::setprecision(1)
+              << std::setw(6) << r.visited / mean / 1e6 << " M nodes/s, latency mean "
+              << mean * 1e6 << " us, p50 " << r.lat[r.lat.size() / 2] * 1e6
+              << " us, max " << r.lat.back() * 1e6 << " us" << std::endl;
+}
+
+}
+
+/**
+ * usage: paths [sites] [pairs] [claimed %]
+ * Searches between random pairs of sites on a grid and on a random
+ * geometric map of about `sites` sites, a share of the rivers claimed by
+ * someone else.
+ */
+int
+paths_main(int argc, char** argv)
+{
+    int sites = argc > 1 ? atoi(argv[1]) : 250000;
+    int pairs_n = argc > 2 ? atoi(argv[2]) : 200;
+    int claimed = argc > 3 ? atoi(argv[3]) : 20;
+
+    int side = static_cast<int>(sqrt(sites));
+    struct Map { const char* name; proto::Setup setup; };
+    std::vector<Map> maps = {
+        {"grid", grid_setup(side, side, 4, 2)},
+        {"geometric", geometric_setup(sites, 8, 4, 2)},
+    };
+    int mismatches = 0;
+    for (auto& m: maps) {
+        QuietState quiet;
+        State state(m.setup);
+        std::mt19937 rng(5);
+        // the opponent owns a share of the rivers, in one big move
+        proto::Moves moves;
+        for (uint32_t idx = 0; idx < state.num_edges(); ++idx) {
+            Edge* e = state.get_edge(idx);
+            if (rng() % 100 < static_cast<uint32_t>(claimed)) moves.push_back(state.claim_edge(e->source, e->target, 1));
+        }
+        state.update(moves);
+        quiet.release();
+
+        std::vector<std::pair<uint32_t, uint32_t>> pairs;
+        while (static_cast<int>(pairs.size()) < pairs_n) {
+            uint32_t a = rng() % state.num_nodes(), b = rng() % state.num_nodes();
+            if (a != b) pairs.emplace_back(a, b);
+        }
+        std::cout << m.name << ": " << state.num_nodes() << " sites, " << state.num_edges() << " rivers, "
+                  << claimed << "% claimed, " << pairs.size() << " pairs" << std::endl;
+        Run one = run(&state, shortest_path_bfs, pairs);
+        Run two = run(&state, shortest_path_bidir, pairs);
+        report("bfs", one);
+        report("bidir", two);
+        for (size_t i = 0; i < pairs.size(); ++i) mismatches += one.lengths[i] != two.lengths[i];
+    }
+    std::cout << "path length mismatches: " << mismatches << std::endl;
+    return mismatches == 0 ? 0 : 1;
+}
+
+}
@@ -0,0 +1,258 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+#include "state.h"
+#include "game.h"
+#include "picojson/picojson.h"
+
+namespace bench {
+
+namespace {
+
+/** latency and heap allocations of every call of one phase */
+struct Phase {
+    explicit Phase(const char* name): name(name) {}
+
+    template<typename F>
+    void time(F fn) {
+        Allocations before = allocations();
+        auto start = Clock::now();
+        fn();
+        double secs = seconds_since(start);
+        Allocations after = allocations();
+        lat.push_back(secs);
+        allocs.push_back(after.count - before.count);
+        bytes += after.bytes - before.bytes;
+    }
+
+    void report() const {
+        if (lat.empty()) return;
+        std::vector<double> l = lat;
+        std::vector<uint64_t> a = allocs;
+        std::sort(l.begin(), l.end());
+        std::sort(a.begin(), a.end());
+        auto pct = [&](double p) { return l[std::min(l.size() - 1, static_cast<size_t>(p * l.size()))] * 1e3; };
+        double mean_allocs = 0;
+        for (uint64_t n: a) mean_allocs += n;
+        mean_allocs /= a.size();
+        std::cout << "  " << std::left << std::setw(10) << name << std::right << std::setw(5) << l.size()
+                  << " calls: " << std::fixed << std::setprecision(3)
+                  << "p50 " << std::setw(8) << pct(0.5) << " ms, p90 " << std::setw(8) << pct(0.9)
+                  << " ms, p99 " << std::setw(8) << pct(0.99) << " ms, max " << std::setw(8) << l.back() * 1e3
+                  << " ms; allocs mean " << std::setprecision(1) << std::setw(8) << mean_allocs
+                  << ", max " << std::setw(6) << a.back() << ", " << std::setprecision(2)
+                  << bytes / double(1 << 20) / l.size() << " MB/call" << std::endl;
+    }
+
+    const char* name;
+    std::vector<double> lat;
+    std::vector<uint64_t> allocs;
+    uint64_t bytes = 0;
+};
+
+bool
+read_file(const char* path, std::string* out)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    *out = ss.str();
+    return true;
+}
+
+/** move message of a round, as the server sends it minus the state */
+std::string
+moves_message(const proto::Moves& last)
+{
+    std::string out = "{\"move\":{\"moves\":[", msg;
+    for (size_t p = 0; p < last.size(); ++p) {
+        proto::write_move(last[p], nullptr, &msg);
+        if (p > 0) out += ',';
+        out += msg;
+    }
+    out += "]}}";
+    return out;
+}
+
+/**
+ * Play a game on the setup and write the move messages we get, one per
+ * line: we move with make_move, everybody else claims random free rivers.
+ */
+int
+record(const std::string& raw_setup, const char* path, double budget)
+{
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "cannot write " << path << std::endl;
+        return 1;
+    }
+    QuietState quiet;
+    proto::SetupView setup(raw_setup);
+    State state(setup);
+    state.init_execution_plan();
+
+    std::mt19937 rng(7);
+    proto::Moves last;
+    for (int p = 0; p < setup.punters; ++p) last.push_back(proto::Move::pass(p));
+    // rivers claimed since our last turn, state does not know them yet
+    std::vector<char> taken(state.num_edges(), 0);
+    size_t lines = 0;
+    for (uint32_t turn = 0; turn < state.num_edges(); ++turn) {
+        int p = turn % setup.punters;
+        if (p == setup.punter) {
+            out << moves_message(last) << '\n';
+            ++lines;
+            state.update(last);
+            std::fill(taken.begin(), taken.end(), 0);
+            if (budget > 0) {
+                Deadline deadline(Deadline::Clock::now(), budget);
+                make_move(&state, &last[p], &deadline);
+            } else {
+                make_move(&state, &last[p]);
+            }
+            if (last[p].move_type == proto::CLAIM) {
+                Edge* e = state.find_edge(state.internal_id(last[p].source), state.internal_id(last[p].target));
+                taken[state.edge_id(e)] = 1;
+            }
+            for (size_t idx = 1; idx < last[p].route.size(); ++idx) {
+                Edge* e = state.find_edge(state.internal_id(last[p].route[idx - 1]),
+                                          state.internal_id(last[p].route[idx]));
+                taken[state.edge_id(e)] = 1;
+            }
+            continue;
+        }
+        last[p] = proto::Move::pass(p);
+        uint32_t pick = rng() % state.num_edges();
+        for (uint32_t i = 0; i < state.num_edges(); ++i, pick = (pick + 1) % state.num_edges()) {
+            Edge* e = state.get_edge(pick);
+            if (e->is_unclaimed() && !taken[pick]) {
+                taken[pick] = 1;
+                last[p] = state.claim_edge(e->source, e->target, p);
+                break;
+            }
+        }
+    }
+    std::cout << "recorded " << lines << " move messages to " << path << std::endl;
+    return 0;
+}
+
+}
+
+/**
+ * usage: replay [--record] <setup message file> <moves file> [budget ms]
+ * Replays a recorded game the way the offline binary sees it: the setup
+ * message through proto::SetupView, then for each line of the moves file a
+ * move message carrying the state we sent last. Reports latency percentiles
+ * and heap allocations of every phase, and of setup through a picojson
+ * tree for comparison. With --record, plays a game on the setup against random
+ * opponents first and writes the moves file. Moves are unlimited in time
+ * without a budget.
+ */
+int
+replay_main(int argc, char** argv)
+{
+    bool recording = argc > 1 && strcmp(argv[1], "--record") == 0;
+    if (recording) {
+        --argc;
+        ++argv;
+    }
+    if (argc < 3) {
+        std::cerr << "usage: replay [--record] <setup message file> <moves file> [budget ms]" << std::endl;
+        return 1;
+    }
+    double budget = argc > 3 ? atof(argv[3]) / 1e3 : 0;
+    std::string raw_setup;
+    if (!read_file(argv[1], &raw_setup)) {
+        std::cerr << "cannot read " << argv[1] << std::endl;
+        return 1;
+    }
+    if (recording && record(raw_setup, argv[2], budget) != 0) return 1;
+
+    std::vector<std::string> messages;
+    {
+        std::ifstream in(argv[2]);
+        if (!in) {
+            std::cerr << "cannot read " << argv[2] << std::endl;
+            return 1;
+        }
+        for (std::string line; std::getline(in, line);) {
+            if (!line.empty()) messages.push_back(line);
+        }
+    }
+
+    Phase scan_setup("SetupView"), build("State"), plan("plan"), setup_serialize("serialize");
+    Phase dom_setup("picojson");
+    Phase read_moves("read_moves"), decode("decode"), update("update"), move("make_move"), serialize("serialize");
+
+    QuietState quiet;
+    // for comparison only: the picojson tree and proto::Setup way to a State
+    dom_setup.time([&]() {
+        picojson::value jsn;
+        picojson::parse(jsn, raw_setup);
+        proto::Setup setup = proto::read_setup(jsn.get<picojson::object>());
+        State state(setup);
+    });
+
+    auto start = Clock::now();
+    std::unique_ptr<proto::SetupView> setup;
+    scan_setup.time([&]() { setup.reset(new proto::SetupView(raw_setup)); });
+    std::unique_ptr<State> state;
+    build.time([&]() { state.reset(new State(*setup)); });
+    plan.time([&]() { state->init_execution_plan(); });
+    std::string blob;
+    setup_serialize.time([&]() { state->serialize(&blob); });
+    uint32_t nodes = state->num_nodes(), edges = state->num_edges(), mines = state->num_mines();
+    state.reset();
+
+    std::string raw;
+    for (const std::string& m: messages) {
+        // the server sends our state back inside the message
+        size_t close = m.rfind('}');
+        raw.assign(m, 0, close);
+        raw += ",\"state\":\"";
+        raw += blob;
+        raw += "\"}";
+
+        proto::Moves moves;
+        proto::Slice state_text;
+        read_moves.time([&]() { proto::read_moves(&raw, &moves, &state_text); });
+        decode.time([&]() { state.reset(new State(state_text.data, state_text.size)); });
+        update.time([&]() { state->update(moves); });
+        proto::Move reply;
+        move.time([&]() {
+            if (budget > 0) {
+                Deadline deadline(Deadline::Clock::now(), budget);
+                make_move(state.get(), &reply, &deadline);
+            } else {
+                make_move(state.get(), &reply);
+            }
+        });
+        serialize.time([&]() {
+            blob.clear();
+            state->serialize(&blob);
+        });
+    }
+    double total = seconds_since(start);
+
+    std::cout << argv[1] << ": " << nodes << " sites, " << edges << " rivers, " << mines << " mines, "
+              << setup->punters << " punters, " << messages.size() << " move messages, "
+              << std::fixed << std::setprecision(3) << total << " s" << std::endl;
+    std::cout << "setup" << std::endl;
+    for (const Phase* p: {&scan_setup, &build, &plan, &setup_serialize}) p->report();
+    std::cout << "setup through a picojson tree, not what the binary does" << std::endl;
+    dom_setup.report();
+    std::cout << "moves" << std::endl;
+    for (const Phase* p: {&read_moves, &decode, &update, &move, &serialize}) p->report();
+    return 0;
+}
+
+}
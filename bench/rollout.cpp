@@ -0,0 +1,63 @@
+#include "bench.h"
+
+#include <iostream>
+#include <iomanip>
+#include <stdlib.h>
+#include "state.h"
+#include "rollout.h"
+
+namespace bench {
+
+/**
+ * usage: rollout [grid side] [punters] [claimed %]
+ * Playouts per second from a position with part of the rivers claimed,
+ * on one thread and on the whole pool.
+ */
+int
+rollout_main(int argc, char** argv)
+{
+    int side = argc > 1 ? atoi(argv[1]) : 100;
+    int punters = argc > 2 ? atoi(argv[2]) : 2;
+    int claimed = argc > 3 ? atoi(argv[3]) : 30;
+
+    auto setup = grid_setup(side, side, side / 4 + 1, punters);
+    QuietState quiet;
+    State state(setup);
+    state.init_execution_plan();
+
+    // claim a share of the rivers round robin, in a fixed pseudo-random order
+    uint32_t step = 7919 % state.num_edges() ? 7919 : 7907;
+    uint32_t to_claim = static_cast<uint64_t>(state.num_edges()) * claimed / 100 / punters * punters;
+    for (uint32_t i = 0, idx = 0; i < to_claim; i += punters) {
+        proto::Moves moves;
+        for (int p = 0; p < punters; ++p, idx = (idx + step) % state.num_edges()) {
+            Edge* e = state.get_edge(idx);
+            moves.push_back(state.claim_edge(e->source, e->target, p));
+        }
+        state.update(moves);
+    }
+    std::vector<uint32_t> candidates;
+    for (uint32_t idx = 0; idx < state.num_edges() && candidates.size() < 8; ++idx) {
+        if (state.get_edge(idx)->is_unclaimed()) candidates.push_back(idx);
+    }
+    quiet.release();
+
+    std::cout << side << "x" << side << " grid, " << state.num_edges() << " rivers, "
+              << state.num_mines() << " mines, " << punters << " punters, "
+              << claimed << "% claimed, " << candidates.size() << " candidates" << std::endl;
+    ThreadPool single(1);
+    for (ThreadPool* pool: {&single, &thread_pool()}) {
+        Rollouts rollouts(&state, *pool);
+        std::vector<double> mean;
+        Deadline deadline(Deadline::Clock::now(), 1.0);
+        auto start = Clock::now();
+        uint32_t playouts = rollouts.evaluate(candidates, 1 << 20, &deadline, &mean);
+        double secs = seconds_since(start);
+        std::cout << "  " << std::setw(2) << pool->size() << " threads: " << std::fixed << std::setprecision(0)
+                  << playouts * candidates.size() / secs << " playouts/s, mean score of first "
+                  << mean[0] << std::endl;
+    }
+    return 0;
+}
+
+}
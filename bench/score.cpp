@@ -0,0 +1,103 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <stdlib.h>
+#include "state.h"
+#include "score.h"
+
+namespace bench {
+
+/**
+ * usage: score [grid side] [punters] [checks]
+ * Plays a random game to the end. Scores are kept up to date move by move
+ * and compared against naive_score() at `checks` points along the way.
+ */
+int
+score_main(int argc, char** argv)
+{
+    int side = argc > 1 ? atoi(argv[1]) : 100;
+    int punters = argc > 2 ? atoi(argv[2]) : 4;
+    int checks = argc > 3 ? atoi(argv[3]) : 50;
+
+    auto setup = grid_setup(side, side, side / 4 + 1, punters);
+    QuietState quiet;
+    State state(setup), plain(setup);
+    state.init_execution_plan();
+    plain.init_execution_plan();
+    Scores* scores = state.scores();
+    if (scores == nullptr) {
+        quiet.release();
+        std::cerr << "no distance table for " << state.num_mines() << " mines on this map" << std::endl;
+        return 1;
+    }
+
+    std::mt19937 rng(11);
+    std::vector<uint32_t> order(state.num_edges());
+    for (uint32_t idx = 0; idx < order.size(); ++idx) order[idx] = idx;
+    std::shuffle(order.begin(), order.end(), rng);
+
+    uint32_t rounds = order.size() / punters;
+    uint32_t check_every = std::max(1u, rounds / std::max(1, checks));
+    double inc_secs = 0, plain_secs = 0, naive_secs = 0;
+    int naive_runs = 0, mismatches = 0;
+    size_t next = 0;
+    for (uint32_t round = 0; round < rounds; ++round) {
+        proto::Moves moves;
+        for (int p = 0; p < punters; ++p) {
+            Edge* e = state.get_edge(order[next]);
+            if (rng() % 8 == 0 && state.get_header()->options_avail > moves.size()) {
+                // option on someone else's river now and then
+                uint32_t id = order[rng() % next];
+                Edge* o = state.get_edge(id);
+                proto::Move option = state.execute_option(o->source, o->target, p);
+                bool taken = false;
+                for (const auto& m: moves) taken = taken || (m.source == option.source && m.target == option.target);
+                if (!taken && o->can_exec_opt() && state.claim_owner(id) != static_cast<uint32_t>(p)) {
+                    moves.push_back(option);
+                    continue;
+                }
+            }
+            moves.push_back(state.claim_edge(e->source, e->target, p));
+            ++next;
+        }
+        auto start = Clock::now();
+        state.update(moves);
+        inc_secs += seconds_since(start);
+        start = Clock::now();
+        plain.update(moves);
+        plain_secs += seconds_since(start);
+
+        if (round % check_every == 0 || round + 1 == rounds) {
+            for (int p = 0; p < punters; ++p) {
+                start = Clock::now();
+                int64_t expected = naive_score(&state, p);
+                naive_secs += seconds_since(start);
+                mismatches += expected != scores->score(p);
+            }
+            ++naive_runs;
+        }
+    }
+
+    // owners survive the round trip, a fresh build agrees
+    State loaded(state.serialize());
+    for (int p = 0; p < punters; ++p) {
+        mismatches += loaded.scores()->score(p) != scores->score(p);
+    }
+
+    std::cout << side << "x" << side << " grid, " << state.num_nodes() << " nodes, "
+              << state.num_edges() << " rivers, " << state.num_mines() << " mines, "
+              << punters << " punters, " << rounds << " rounds" << std::endl
+              << std::fixed << std::setprecision(3)
+              << "  update: " << plain_secs / rounds * 1e6 << " us/round, with scores "
+              << inc_secs / rounds * 1e6 << " us/round" << std::endl
+              << "  naive, all punters: " << naive_secs / naive_runs * 1e6 << " us" << std::endl
+              << "  final scores:";
+    for (int p = 0; p < punters; ++p) std::cout << " " << scores->score(p);
+    std::cout << std::endl << "  mismatches: " << mismatches << std::endl;
+    return mismatches == 0 ? 0 : 1;
+}
+
+}
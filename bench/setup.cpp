@@ -0,0 +1,69 @@
+#include "bench.h"
+
+#include <iostream>
+#include <iomanip>
+#include <stdlib.h>
+#include "state.h"
+#include "picojson/picojson.h"
+
+namespace bench {
+
+namespace {
+
+void
+report(const char* name, const Isolated& r)
+{
+    std::cout << "  " << std::setw(8) << name << ": "
+              << std::fixed << std::setprecision(1) << std::setw(9) << r.seconds * 1e3 << " ms, peak RSS "
+              << std::setw(7) << r.peak_rss_kb / 1024.0 << " MB, " << std::setw(8) << r.allocs
+              << " allocations, " << std::setw(7) << r.alloc_bytes / double(1 << 20) << " MB" << std::endl;
+}
+
+}
+
+/**
+ * usage: setup [grid side...]
+ * Setup message to a State on grids of the given sides, each way in a
+ * process of its own: time, peak RSS and heap allocations. plan is the
+ * streaming way plus the execution plan.
+ */
+int
+setup_main(int argc, char** argv)
+{
+    std::vector<int> sides;
+    for (int i = 1; i < argc; ++i) sides.push_back(atoi(argv[i]));
+    if (sides.empty()) sides = {100, 316, 1000};
+
+    for (int side: sides) {
+        std::string raw = setup_json(grid_setup(side, side, side / 4 + 1, 2));
+        std::cout << side << "x" << side << " grid, " << std::fixed << std::setprecision(1)
+                  << raw.size() / double(1 << 20) << " MB message" << std::endl;
+        QuietState quiet;
+
+        report("baseline", run_isolated([]() { return 0.0; }));
+        report("dom", run_isolated([&]() {
+            auto start = Clock::now();
+            picojson::value jsn;
+            picojson::parse(jsn, raw);
+            auto setup = proto::read_setup(jsn.get<picojson::object>());
+            State state(setup);
+            return seconds_since(start);
+        }));
+        report("stream", run_isolated([&]() {
+            auto start = Clock::now();
+            proto::SetupView setup(raw);
+            State state(setup);
+            return seconds_since(start);
+        }));
+        report("plan", run_isolated([&]() {
+            auto start = Clock::now();
+            proto::SetupView setup(raw);
+            State state(setup);
+            state.init_execution_plan();
+            return seconds_since(start);
+        }));
+    }
+    return 0;
+}
+
+}
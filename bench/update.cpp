@@ -0,0 +1,143 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <stdlib.h>
+#include "state.h"
+
+namespace bench {
+
+namespace {
+
+/** find_edge as it was: scan the source's whole adjacency */
+Edge*
+linear_find(State* state, uint32_t source, uint32_t target)
+{
+    auto it = state->get_edges_iter(source);
+    for (uint32_t ref = it.first; ref < it.second; ++ref) {
+        if (state->neighbor_by_ref(ref) == target) return state->get_edge_by_ref(ref);
+    }
+    return nullptr;
+}
+
+/**
+ * Whole game as move messages of `batch` moves each: every river claimed
+ * once in random order, by punters in turn, a quarter of the moves being
+ * splurges along free rivers.
+ */
+std::vector<proto::Moves>
+play(State* state, int punters, int batch, std::mt19937* rng)
+{
+    std::vector<uint32_t> order(state->num_edges());
+    for (uint32_t idx = 0; idx < order.size(); ++idx) order[idx] = idx;
+    std::shuffle(order.begin(), order.end(), *rng);
+    std::vector<char> taken(state->num_edges(), 0);
+
+    std::vector<proto::Moves> out(1);
+    int p = 0;
+    for (uint32_t id: order) {
+        if (taken[id]) continue;
+        taken[id] = 1;
+        Edge* e = state->get_edge(id);
+        std::vector<int> route = {static_cast<int>(state->external_id(e->source)),
+                                  static_cast<int>(state->external_id(e->target))};
+        uint32_t at = e->target;
+        while ((*rng)() % 4 == 0 && route.size() <= 8) {
+            auto it = state->get_edges_iter(at);
+            uint32_t ref = it.first;
+            while (ref < it.second && taken[state->edge_id_by_ref(ref)]) ++ref;
+            if (ref == it.second) break;
+            taken[state->edge_id_by_ref(ref)] = 1;
+            at = state->neighbor_by_ref(ref);
+            route.push_back(state->external_id(at));
+        }
+        if (static_cast<int>(out.back().size()) == batch) out.emplace_back();
+        out.back().push_back(route.size() == 2 ? proto::Move::claim(p, route[0], route[1])
+                                               : proto::Move::splurge(p, route));
+        p = (p + 1) % punters;
+    }
+    return out;
+}
+
+}
+
+/**
+ * usage: update [sites] [punters] [batch]
+ * find_edge lookups and State::update over move messages of `batch` moves
+ * on a scale-free map, where a few hubs have thousands of rivers, and on a
+ * grid of about the same size.
+ */
+int
+update_main(int argc, char** argv)
+{
+    int sites = argc > 1 ? atoi(argv[1]) : 100000;
+    int punters = argc > 2 ? atoi(argv[2]) : 16;
+    int batch = argc > 3 ? atoi(argv[3]) : 1000;
+
+    int side = static_cast<int>(sqrt(sites));
+    struct Map { const char* name; proto::Setup setup; };
+    std::vector<Map> maps = {
+        {"scale-free", scale_free_setup(sites, 3, 4, punters)},
+        {"grid", grid_setup(side, side, 4, punters)},
+    };
+    int mismatches = 0;
+    for (auto& m: maps) {
+        QuietState quiet;
+        State state(m.setup);
+        std::mt19937 rng(3);
+
+        uint32_t max_degree = 0;
+        for (uint32_t n = 0; n + 1 < state.num_nodes(); ++n) {
+            auto it = state.get_edges_iter(n);
+            max_degree = std::max(max_degree, it.second - it.first);
+        }
+        std::cout << m.name << ": " << state.num_nodes() - 1 << " sites, " << state.num_edges()
+                  << " rivers, max degree " << max_degree << ", " << punters << " punters, "
+                  << batch << " moves per message" << std::endl;
+
+        // lookups of random rivers, either way round
+        std::vector<std::pair<uint32_t, uint32_t>> lookups(1000000);
+        for (auto& l: lookups) {
+            Edge* e = state.get_edge(rng() % state.num_edges());
+            uint32_t a = e->source, b = e->target;
+            l = rng() % 2 ? std::make_pair(a, b) : std::make_pair(b, a);
+        }
+        auto start = Clock::now();
+        for (const auto& l: lookups) mismatches += state.find_edge(l.first, l.second) == nullptr;
+        double sorted_secs = seconds_since(start);
+        start = Clock::now();
+        for (const auto& l: lookups) mismatches += linear_find(&state, l.first, l.second) == nullptr;
+        double linear_secs = seconds_since(start);
+        for (size_t idx = 0; idx < lookups.size(); idx += 97) {
+            const auto& l = lookups[idx];
+            mismatches += state.find_edge(l.first, l.second) != linear_find(&state, l.first, l.second);
+        }
+        std::cout << std::fixed << std::setprecision(1)
+                  << "  find_edge: " << sorted_secs / lookups.size() * 1e9 << " ns, linear scan "
+                  << linear_secs / lookups.size() * 1e9 << " ns" << std::endl;
+
+        std::vector<proto::Moves> messages = play(&state, punters, batch, &rng);
+        std::vector<double> lat;
+        size_t rivers = 0;
+        for (const auto& moves: messages) {
+            start = Clock::now();
+            state.update(moves);
+            lat.push_back(seconds_since(start));
+            for (const auto& mv: moves) rivers += mv.move_type == proto::SPLURGE ? mv.route.size() - 1 : 1;
+        }
+        for (uint32_t idx = 0; idx < state.num_edges(); ++idx) mismatches += state.get_edge(idx)->is_unclaimed();
+        double total = 0;
+        for (double l: lat) total += l;
+        std::sort(lat.begin(), lat.end());
+        std::cout << "  update: " << messages.size() << " messages, " << rivers << " rivers, "
+                  << std::setprecision(3) << total / messages.size() * 1e3 << " ms/message, p99 "
+                  << lat[std::min(lat.size() - 1, lat.size() * 99 / 100)] * 1e3 << " ms, "
+                  << std::setprecision(1) << total / rivers * 1e9 << " ns/river" << std::endl;
+    }
+    std::cout << "mismatches: " << mismatches << std::endl;
+    return mismatches == 0 ? 0 : 1;
+}
+
+}
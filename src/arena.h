@@ -0,0 +1,52 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <type_traits>
+#include <vector>
+#include <cstddef>
+
+/**
+ * Bump allocator for scratch arrays that all die together, setup mostly:
+ * a few big blocks instead of a heap allocation per array, freed at once
+ * with the arena. Memory comes uninitialized and nothing is destroyed, so
+ * it only holds trivial types.
+ */
+class Arena {
+public:
+    explicit Arena(size_t block_size = 1 << 20): block_size(block_size) {}
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    /** room for n values of T */
+    template<typename T>
+    T* alloc(size_t n) {
+        static_assert(std::is_trivially_destructible<T>::value, "arena never runs destructors");
+        static_assert(alignof(T) <= alignof(std::max_align_t), "blocks are max_align_t aligned");
+        size_t at = (used + alignof(T) - 1) / alignof(T) * alignof(T);
+        if (blocks.empty() || at + n * sizeof(T) > capacity) {
+            // bigger requests get a block of their own size
+            capacity = std::max(block_size, n * sizeof(T));
+            blocks.emplace_back(new std::max_align_t[(capacity + sizeof(std::max_align_t) - 1)
+                                                     / sizeof(std::max_align_t)]);
+            at = 0;
+        }
+        used = at + n * sizeof(T);
+        return reinterpret_cast<T*>(reinterpret_cast<char*>(blocks.back().get()) + at);
+    }
+
+    /** n copies of value */
+    template<typename T>
+    T* alloc(size_t n, const T& value) {
+        T* p = alloc<T>(n);
+        std::fill(p, p + n, value);
+        return p;
+    }
+
+private:
+    std::vector<std::unique_ptr<std::max_align_t[]>> blocks;
+    size_t block_size;
+    size_t capacity = 0; // of the last block, in bytes
+    size_t used = 0;     // of the last block, in bytes
+};
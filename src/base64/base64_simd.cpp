@@ -0,0 +1,323 @@
+#include "base64_simd.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BASE64_X86 1
+#include <immintrin.h>
+#endif
+
+namespace base64 {
+
+namespace {
+
+const char kAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+    "abcdefghijklmnopqrstuvwxyz"
+    "0123456789+/";
+
+const uint8_t kInvalid = 0xff;
+
+struct DecodeTable {
+    uint8_t v[256];
+    DecodeTable() {
+        memset(v, kInvalid, sizeof(v));
+        for (uint8_t i = 0; i < 64; ++i) {
+            v[static_cast<uint8_t>(kAlphabet[i])] = i;
+        }
+    }
+};
+
+const DecodeTable kDecode;
+
+/** encode whole 3-byte groups plus tail with padding; return chars written */
+size_t
+encode_scalar(const uint8_t* in, size_t len, char* out)
+{
+    char* o = out;
+    size_t i = 0;
+    for (; i + 3 <= len; i += 3) {
+        uint32_t v = (in[i] << 16) | (in[i + 1] << 8) | in[i + 2];
+        o[0] = kAlphabet[(v >> 18) & 0x3f];
+        o[1] = kAlphabet[(v >> 12) & 0x3f];
+        o[2] = kAlphabet[(v >> 6) & 0x3f];
+        o[3] = kAlphabet[v & 0x3f];
+        o += 4;
+    }
+    if (i < len) {
+        uint32_t v = in[i] << 16;
+        if (i + 1 < len) v |= in[i + 1] << 8;
+        o[0] = kAlphabet[(v >> 18) & 0x3f];
+        o[1] = kAlphabet[(v >> 12) & 0x3f];
+        o[2] = i + 1 < len ? kAlphabet[(v >> 6) & 0x3f] : '=';
+        o[3] = '=';
+        o += 4;
+    }
+    return o - out;
+}
+
+/** decode unpadded input; return false on invalid characters */
+bool
+decode_scalar(const uint8_t* in, size_t len, char* out)
+{
+    uint8_t bad = 0;
+    size_t i = 0;
+    for (; i + 4 <= len; i += 4) {
+        uint8_t a = kDecode.v[in[i]], b = kDecode.v[in[i + 1]];
+        uint8_t c = kDecode.v[in[i + 2]], d = kDecode.v[in[i + 3]];
+        bad |= a | b | c | d;
+        uint32_t v = (a << 18) | (b << 12) | (c << 6) | d;
+        *out++ = static_cast<char>(v >> 16);
+        *out++ = static_cast<char>(v >> 8);
+        *out++ = static_cast<char>(v);
+    }
+    size_t rest = len - i;
+    if (rest >= 2) {
+        uint8_t a = kDecode.v[in[i]], b = kDecode.v[in[i + 1]];
+        uint8_t c = rest == 3 ? kDecode.v[in[i + 2]] : 0;
+        bad |= a | b | c;
+        uint32_t v = (a << 18) | (b << 12) | (c << 6);
+        *out++ = static_cast<char>(v >> 16);
+        if (rest == 3) *out++ = static_cast<char>(v >> 8);
+    }
+    return (bad & 0xc0) == 0;
+}
+
+#ifdef BASE64_X86
+
+// Encoding follows Wojciech Mula's scheme: shuffle 3-byte groups into 32-bit
+// lanes, split them into four 6-bit indices with multiplies, then map indices
+// to ASCII by adding a per-range offset picked with pshufb.
+// Decoding reverses it and validates the input with two nibble lookups.
+
+__attribute__((target("sse4.1")))
+inline __m128i
+enc_translate_sse(__m128i indices)
+{
+    const __m128i shift_lut = _mm_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+        '/' - 63, 'A', 0, 0);
+    __m128i result = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    const __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    result = _mm_or_si128(result, _mm_and_si128(less, _mm_set1_epi8(13)));
+    result = _mm_shuffle_epi8(shift_lut, result);
+    return _mm_add_epi8(result, indices);
+}
+
+__attribute__((target("sse4.1")))
+size_t
+encode_sse(const uint8_t* in, size_t len, char* out)
+{
+    const __m128i shuf = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    size_t i = 0;
+    char* o = out;
+    for (; i + 16 <= len; i += 12) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        v = _mm_shuffle_epi8(v, shuf);
+        const __m128i t0 = _mm_and_si128(v, _mm_set1_epi32(0x0fc0fc00));
+        const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+        const __m128i t2 = _mm_and_si128(v, _mm_set1_epi32(0x003f03f0));
+        const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+        const __m128i indices = _mm_or_si128(t1, t3);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(o), enc_translate_sse(indices));
+        o += 16;
+    }
+    return (o - out) + encode_scalar(in + i, len - i, o);
+}
+
+__attribute__((target("sse4.1")))
+bool
+decode_sse(const uint8_t* in, size_t len, char* out)
+{
+    const __m128i lut_lo = _mm_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m128i lut_hi = _mm_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lut_roll = _mm_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71,
+        0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask_2f = _mm_set1_epi8(0x2f);
+    const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+    size_t i = 0;
+    // each store writes 16 bytes of which 12 are valid, caller provides slack
+    for (; i + 16 <= len; i += 16) {
+        __m128i str = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        const __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(str, 4), mask_2f);
+        const __m128i lo_nibbles = _mm_and_si128(str, mask_2f);
+        const __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+        const __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+        if (!_mm_testz_si128(lo, hi)) return false;
+        const __m128i eq_2f = _mm_cmpeq_epi8(str, mask_2f);
+        const __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2f, hi_nibbles));
+        str = _mm_add_epi8(str, roll);
+        const __m128i ab_bc = _mm_maddubs_epi16(str, _mm_set1_epi32(0x01400140));
+        const __m128i packed = _mm_madd_epi16(ab_bc, _mm_set1_epi32(0x00011000));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi8(packed, pack));
+        out += 12;
+    }
+    return decode_scalar(in + i, len - i, out);
+}
+
+__attribute__((target("avx2")))
+size_t
+encode_avx2(const uint8_t* in, size_t len, char* out)
+{
+    const __m256i shuf = _mm256_set_epi8(
+        10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+        10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    const __m256i shift_lut = _mm256_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+        '/' - 63, 'A', 0, 0,
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+        '/' - 63, 'A', 0, 0);
+    size_t i = 0;
+    char* o = out;
+    for (; i + 28 <= len; i += 24) {
+        const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 12));
+        __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        v = _mm256_shuffle_epi8(v, shuf);
+        const __m256i t0 = _mm256_and_si256(v, _mm256_set1_epi32(0x0fc0fc00));
+        const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+        const __m256i t2 = _mm256_and_si256(v, _mm256_set1_epi32(0x003f03f0));
+        const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+        const __m256i indices = _mm256_or_si256(t1, t3);
+        __m256i result = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        const __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+        result = _mm256_or_si256(result, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+        result = _mm256_shuffle_epi8(shift_lut, result);
+        result = _mm256_add_epi8(result, indices);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(o), result);
+        o += 32;
+    }
+    return (o - out) + encode_sse(in + i, len - i, o);
+}
+
+__attribute__((target("avx2")))
+bool
+decode_avx2(const uint8_t* in, size_t len, char* out)
+{
+    const __m256i lut_lo = _mm256_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m256i lut_hi = _mm256_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lut_roll = _mm256_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71,
+        0, 0, 0, 0, 0, 0, 0, 0,
+        0, 16, 19, 4, -65, -65, -71, -71,
+        0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i mask_2f = _mm256_set1_epi8(0x2f);
+    const __m256i pack = _mm256_setr_epi8(
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, -1, -1);
+
+    size_t i = 0;
+    // each store writes 32 bytes of which 24 are valid, caller provides slack
+    for (; i + 32 <= len; i += 32) {
+        __m256i str = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        const __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(str, 4), mask_2f);
+        const __m256i lo_nibbles = _mm256_and_si256(str, mask_2f);
+        const __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+        const __m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+        if (!_mm256_testz_si256(lo, hi)) return false;
+        const __m256i eq_2f = _mm256_cmpeq_epi8(str, mask_2f);
+        const __m256i roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(eq_2f, hi_nibbles));
+        str = _mm256_add_epi8(str, roll);
+        const __m256i ab_bc = _mm256_maddubs_epi16(str, _mm256_set1_epi32(0x01400140));
+        __m256i packed = _mm256_madd_epi16(ab_bc, _mm256_set1_epi32(0x00011000));
+        packed = _mm256_shuffle_epi8(packed, pack);
+        packed = _mm256_permutevar8x32_epi32(packed, lanes);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), packed);
+        out += 24;
+    }
+    return decode_sse(in + i, len - i, out);
+}
+
+#endif // BASE64_X86
+
+} // namespace
+
+Isa
+detect_isa()
+{
+#ifdef BASE64_X86
+    static const Isa isa = __builtin_cpu_supports("avx2") ? Isa::AVX2
+        : __builtin_cpu_supports("sse4.1") ? Isa::SSE41
+        : Isa::SCALAR;
+    return isa;
+#else
+    return Isa::SCALAR;
+#endif
+}
+
+const char*
+isa_name(Isa isa)
+{
+    switch (isa) {
+    case Isa::SCALAR: return "scalar";
+    case Isa::SSE41: return "sse4.1";
+    case Isa::AVX2: return "avx2";
+    }
+    return "unknown";
+}
+
+void
+encode(const char* in, size_t len, std::string* out, Isa isa)
+{
+    out->clear();
+    append(in, len, out, isa);
+}
+
+void
+append(const char* in, size_t len, std::string* out, Isa isa)
+{
+    size_t offset = out->size();
+    out->resize(offset + encoded_length(len));
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(in);
+    char* dst = &(*out)[offset];
+    switch (isa) {
+#ifdef BASE64_X86
+    case Isa::AVX2: encode_avx2(src, len, dst); return;
+    case Isa::SSE41: encode_sse(src, len, dst); return;
+#endif
+    default: encode_scalar(src, len, dst); return;
+    }
+}
+
+bool
+decode(const char* in, size_t len, std::vector<char>* out, Isa isa)
+{
+    // strip padding, at most two characters
+    for (int pad = 0; pad < 2 && len > 0 && in[len - 1] == '='; ++pad) --len;
+    if (len % 4 == 1) return false;
+    size_t valid = len / 4 * 3 + (len % 4 == 0 ? 0 : len % 4 - 1);
+    // vector stores may run past the valid output, decode into slack space
+    out->resize(valid + 32);
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(in);
+    char* dst = out->data();
+    bool ok;
+    switch (isa) {
+#ifdef BASE64_X86
+    case Isa::AVX2: ok = decode_avx2(src, len, dst); break;
+    case Isa::SSE41: ok = decode_sse(src, len, dst); break;
+#endif
+    default: ok = decode_scalar(src, len, dst); break;
+    }
+    out->resize(valid);
+    return ok;
+}
+
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stddef.h>
+
+/**
+ * Vectorized base64 codec for the state blob.
+ *
+ * Produces exactly the same output as the scalar Base64 class (standard
+ * alphabet, '=' padding). The widest instruction set supported by the running
+ * CPU is picked once at startup; scalar code handles block tails.
+ */
+namespace base64 {
+
+enum class Isa { SCALAR, SSE41, AVX2 };
+
+/** best implementation available on this CPU */
+Isa detect_isa();
+
+const char* isa_name(Isa isa);
+
+inline size_t encoded_length(size_t len) { return (len + 2) / 3 * 4; }
+
+void encode(const char* in, size_t len, std::string* out, Isa isa = detect_isa());
+
+/** encode onto the end of out */
+void append(const char* in, size_t len, std::string* out, Isa isa = detect_isa());
+
+/** return false on malformed input */
+bool decode(const char* in, size_t len, std::vector<char>* out, Isa isa = detect_isa());
+
+inline void encode(const std::vector<char>& in, std::string* out) { encode(in.data(), in.size(), out); }
+inline bool decode(const std::string& in, std::vector<char>* out) { return decode(in.data(), in.size(), out); }
+
+}
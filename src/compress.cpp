@@ -0,0 +1,203 @@
+#include "compress.h"
+
+namespace compress {
+
+namespace {
+
+enum PlaneMode { PLANE_RAW = 0, PLANE_RLE = 1 };
+
+const int kHashBits = 16;
+const size_t kMinMatch = 4;
+
+/** set bits [from, to) */
+void
+fill_ones(std::vector<uint64_t>* plane, uint32_t from, uint32_t to)
+{
+    for (; from < to && from % 64 != 0; ++from) (*plane)[from / 64] |= 1ull << (from % 64);
+    for (; from + 64 <= to; from += 64) (*plane)[from / 64] = ~0ull;
+    for (; from < to; ++from) (*plane)[from / 64] |= 1ull << (from % 64);
+}
+
+/** run lengths of alternating bit values, starting with zeros */
+void
+bit_runs(const std::vector<uint64_t>& plane, uint32_t bits, std::vector<uint32_t>* runs)
+{
+    bool cur = false;
+    uint32_t start = 0;
+    for (uint32_t idx = 0; idx < bits; ) {
+        uint64_t word = plane[idx / 64] >> (idx % 64);
+        // skip whole words equal to the current run value
+        if (idx % 64 == 0 && idx + 64 <= bits && word == (cur ? ~0ull : 0ull)) {
+            idx += 64;
+            continue;
+        }
+        if (((word & 1) != 0) != cur) {
+            runs->push_back(idx - start);
+            start = idx;
+            cur = !cur;
+        }
+        ++idx;
+    }
+    runs->push_back(bits - start);
+}
+
+inline uint32_t
+load32(const char* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t
+load64(const char* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t
+hash32(uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - kHashBits);
+}
+
+/** length of common prefix of a and b, not reading past limit */
+inline size_t
+match_length(const char* a, const char* b, const char* limit)
+{
+    const char* start = b;
+    while (b + 8 <= limit) {
+        uint64_t diff = load64(a) ^ load64(b);
+        if (diff != 0) return (b - start) + (__builtin_ctzll(diff) >> 3);
+        a += 8;
+        b += 8;
+    }
+    while (b < limit && *a == *b) {
+        ++a;
+        ++b;
+    }
+    return b - start;
+}
+
+void
+emit(ByteWriter* w, const char* literals, size_t lit_len, size_t match_len, size_t offset)
+{
+    w->varint(lit_len);
+    w->put(literals, lit_len);
+    w->varint(match_len);
+    if (match_len > 0) w->varint(offset);
+}
+
+}
+
+void
+write_bitplane(ByteWriter* w, const std::vector<uint64_t>& plane, uint32_t bits)
+{
+    size_t raw_bytes = (bits + 7) / 8;
+    std::vector<uint32_t> runs;
+    bit_runs(plane, bits, &runs);
+    size_t rle_bytes = 0;
+    for (uint32_t r: runs) {
+        rle_bytes += 1;
+        for (r >>= 7; r != 0; r >>= 7) ++rle_bytes;
+        if (rle_bytes >= raw_bytes) break;
+    }
+    if (rle_bytes < raw_bytes) {
+        w->varint(PLANE_RLE);
+        for (uint32_t r: runs) w->varint(r);
+    } else {
+        w->varint(PLANE_RAW);
+        w->put(plane.data(), raw_bytes);
+    }
+}
+
+void
+read_bitplane(ByteReader* r, std::vector<uint64_t>* plane, uint32_t bits)
+{
+    plane->assign((bits + 63) / 64, 0);
+    uint32_t mode = r->varint();
+    if (mode == PLANE_RAW) {
+        r->get(plane->data(), (bits + 7) / 8);
+        return;
+    }
+    assert(mode == PLANE_RLE);
+    // runs alternate starting with zeros and add up to bits, there is
+    // always at least one
+    bool cur = false;
+    uint32_t idx = 0;
+    do {
+        uint32_t len = r->varint();
+        assert(idx + len <= bits);
+        if (cur) fill_ones(plane, idx, idx + len);
+        idx += len;
+        cur = !cur;
+    } while (idx < bits);
+}
+
+void
+lz_compress(const char* in, size_t len, std::vector<char>* out)
+{
+    out->clear();
+    out->reserve(len / 2 + 16);
+    ByteWriter w(out);
+    w.varint(len);
+
+    std::vector<uint32_t> table(1 << kHashBits, 0);
+    const char* end = in + len;
+    size_t anchor = 0;
+    size_t idx = 0;
+    while (idx + 8 <= len) {
+        uint32_t seq = load32(in + idx);
+        uint32_t h = hash32(seq);
+        size_t cand = table[h];
+        table[h] = idx;
+        if (cand < idx && load32(in + cand) == seq) {
+            size_t m = kMinMatch + match_length(in + cand + kMinMatch, in + idx + kMinMatch, end);
+            emit(&w, in + anchor, idx - anchor, m, idx - cand);
+            idx += m;
+            anchor = idx;
+            if (idx >= 2 && idx + 2 <= len) table[hash32(load32(in + idx - 2))] = idx - 2;
+        } else {
+            // step faster through incompressible data
+            idx += 1 + ((idx - anchor) >> 6);
+        }
+    }
+    emit(&w, in + anchor, len - anchor, 0, 0);
+}
+
+bool
+lz_decompress(const char* in, size_t len, std::vector<char>* out)
+{
+    ByteReader r(in, len);
+    if (r.left() == 0) return false;
+    out->resize(r.varint());
+    char* begin = out->data();
+    char* o = begin;
+    char* oend = begin + out->size();
+    while (true) {
+        size_t lit = r.varint();
+        if (lit > static_cast<size_t>(oend - o) || lit > r.left()) return false;
+        r.get(o, lit);
+        o += lit;
+        if (r.left() == 0) return false;
+        size_t m = r.varint();
+        if (m == 0) break;
+        size_t offset = r.varint();
+        if (offset == 0 || offset > static_cast<size_t>(o - begin) || m > static_cast<size_t>(oend - o)) {
+            return false;
+        }
+        const char* src = o - offset;
+        if (offset >= m) {
+            memcpy(o, src, m);
+            o += m;
+        } else {
+            // overlapping copy repeats the last `offset` bytes
+            for (size_t i = 0; i < m; ++i) *o++ = *src++;
+        }
+    }
+    return o == oend && r.done();
+}
+
+}
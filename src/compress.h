@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vector>
+#include <cassert>
+#include <cstring>
+#include <stdint.h>
+#include <stddef.h>
+
+/** Byte-level helpers for packing the state blob */
+namespace compress {
+
+class ByteWriter {
+public:
+    ByteWriter(std::vector<char>* out): out(out) {}
+
+    void put(const void* p, size_t sz) {
+        const char* c = reinterpret_cast<const char*>(p);
+        out->insert(out->end(), c, c + sz);
+    }
+
+    void varint(uint32_t v) {
+        while (v >= 0x80) {
+            out->push_back(static_cast<char>(v | 0x80));
+            v >>= 7;
+        }
+        out->push_back(static_cast<char>(v));
+    }
+
+private:
+    std::vector<char>* out;
+};
+
+class ByteReader {
+public:
+    ByteReader(const char* data, size_t sz): pos(data), end(data + sz) {}
+    ByteReader(const std::vector<char>& in): ByteReader(in.data(), in.size()) {}
+
+    void get(void* p, size_t sz) {
+        assert(pos + sz <= end);
+        memcpy(p, pos, sz);
+        pos += sz;
+    }
+
+    uint8_t byte() {
+        assert(pos < end);
+        return static_cast<uint8_t>(*pos++);
+    }
+
+    uint32_t varint() {
+        uint32_t v = 0;
+        for (int shift = 0; ; shift += 7) {
+            uint8_t b = byte();
+            v |= static_cast<uint32_t>(b & 0x7f) << shift;
+            if (b < 0x80) return v;
+        }
+    }
+
+    const char* current() const { return pos; }
+    size_t left() const { return end - pos; }
+    bool done() const { return pos == end; }
+
+private:
+    const char* pos;
+    const char* end;
+};
+
+/**
+ * Write `bits` bits of plane either raw or as alternating run lengths
+ * (zeros first), whichever is shorter.
+ */
+void write_bitplane(ByteWriter* w, const std::vector<uint64_t>& plane, uint32_t bits);
+
+/** plane is resized to hold `bits` bits */
+void read_bitplane(ByteReader* r, std::vector<uint64_t>* plane, uint32_t bits);
+
+/** LZ77 with a single-probe hash table, varint coded tokens */
+void lz_compress(const char* in, size_t len, std::vector<char>* out);
+
+/** return false on corrupt input */
+bool lz_decompress(const char* in, size_t len, std::vector<char>* out);
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <chrono>
+#include <stdint.h>
+
+/**
+ * Point in time a decision is due. Searches poll() it and give up early,
+ * callers keep a best-so-far answer for that case.
+ */
+class Deadline {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    /** never expires */
+    Deadline(): at(Clock::time_point::max()) {}
+
+    Deadline(Clock::time_point start, double seconds):
+        at(start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds))) {}
+
+    bool expired() {
+        if (!passed && Clock::now() >= at) passed = true;
+        return passed;
+    }
+
+    /** for inner loops: reads the clock once every kPollEvery calls */
+    bool poll() {
+        if (++polls % kPollEvery != 0) return passed;
+        return expired();
+    }
+
+    /**
+     * Copy for one thread of a parallel search: poll() keeps a call count
+     * and is not thread safe, so each thread polls a copy of its own.
+     */
+    Deadline for_thread() const { return *this; }
+
+    double seconds_left() const {
+        if (at == Clock::time_point::max()) return 1e9;
+        return std::chrono::duration<double>(at - Clock::now()).count();
+    }
+
+private:
+    static const uint32_t kPollEvery = 256;
+
+    Clock::time_point at;
+    uint32_t polls = 0;
+    bool passed = false;
+};
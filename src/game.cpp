@@ -1,9 +1,21 @@
 #include "game.h"
 
-#include <unordered_set>
-#include <unordered_map>
-#include <queue>
+#include <algorithm>
 #include <random>
+#include "pool.h"
+#include "rollout.h"
+
+namespace {
+
+// rivers compared by playouts once the plan is done
+const size_t kRolloutCandidates = 8;
+// per candidate, more than this hardly changes the pick
+const uint32_t kMaxPlayouts = 64;
+// rivers in one splurge at most, banking passes for longer ones gives the
+// others too much time to cut in
+const size_t kMaxSplurge = 8;
+
+}
 
 /** return number of unclaimed edges from node with given id */
 std::vector<Edge*>
@@ -11,25 +23,22 @@ unclaimed_edges_from(State* state, uint32_t root)
 {
     std::vector<Edge*> res;
     res.reserve(128);
-    std::vector<uint32_t> queue;
-    std::unordered_set<uint32_t> visited;
-    queue.reserve(128);
-    queue.push_back(root);
-    visited.emplace(root);
+    SearchSpace* search = state->new_search();
+    search->push(root);
+    search->visit(root, UNDEFINED);
 
-    while(!queue.empty()) {
-        uint32_t node = queue.back();
+    while(!search->empty()) {
+        uint32_t node = search->pop_back();
 
-        queue.pop_back();
         auto iter = state->get_edges_iter(node);
         for (auto i = iter.first; i < iter.second; ++i) {
             Edge* e = state->get_edge_by_ref(i);
             if (e->claimed_by_me()) {
                 // claimed by me
                 uint32_t t = e->source == node ? e->target: e->source;
-                if (visited.find(t) == visited.end()){
-                    queue.push_back(t);
-                    visited.emplace(t);
+                if (!search->visited(t)){
+                    search->push(t);
+                    search->visit(t, i);
                 }
 
             } else if(e->is_claimed()) {
@@ -48,13 +57,12 @@ unclaimed_edges_from(State* state, uint32_t root)
 
 // return path
 std::vector<Edge*>
-unpack_path(State* state, uint32_t from, uint32_t to, const std::unordered_map<uint32_t, uint32_t>& visited)
+unpack_path(State* state, uint32_t from, uint32_t to, const SearchSpace& search)
 {
     std::vector<Edge*> result;
     uint32_t cur = to;
     do {
-        const auto it = visited.at(cur);
-        Edge* e = state->get_edge_by_ref(it);
+        Edge* e = state->get_edge_by_ref(search.parent_ref(cur));
         result.push_back(e);
         uint32_t prev = e->target != cur ? e->target: e->source;
         cur = prev;
@@ -67,27 +75,24 @@ unpack_path(State* state, uint32_t from, uint32_t to, const std::unordered_map<u
 Edge*
 path_to_nearest_unconnected_mine(State* state, uint32_t root)
 {
-    std::queue<uint32_t> queue;
-    std::unordered_map<uint32_t, uint32_t> visited;
+    SearchSpace* search = state->new_search();
 
-    queue.push(root);
-    visited.emplace(root, UNDEFINED);
+    search->push(root);
+    search->visit(root, UNDEFINED);
 
-    while(!queue.empty()) {
-        uint32_t node = queue.front();
-        queue.pop();
+    while(!search->empty()) {
+        uint32_t node = search->pop_front();
         auto iter = state->get_edges_iter(node);
         for (auto i = iter.first; i < iter.second; ++i) {
-            Edge* e = state->get_edge_by_ref(i);
-            if (e->claimed_by_me() || !e->is_claimed()) {
+            if (state->can_pass(state->edge_id_by_ref(i))) {
                 // can travel
-                uint32_t t = e->source == node ? e->target: e->source;
-                if (visited.find(t) != visited.end()) continue; // already visited
-                queue.push(t);
-                visited.emplace(t, i);
-                if (state->is_mine(t)) {
+                uint32_t t = state->neighbor_by_ref(i);
+                if (search->visited(t)) continue; // already visited
+                search->push(t);
+                search->visit(t, i);
+                if (state->is_mine(t) && !state->connected(root, t)) {
                     // unpack path
-                    auto path = unpack_path(state, root, t, visited);
+                    auto path = unpack_path(state, root, t, *search);
                     std::cerr << "Path found:" << root << " -> " << t << " ===>  ";
                     for (auto it = path.rbegin(); it != path.rend(); ++it) {
                         Edge* eee = *it;
@@ -106,61 +111,154 @@ path_to_nearest_unconnected_mine(State* state, uint32_t root)
     return nullptr;
 }
 
-// return first unclaimed edge ref or nullptr
-Edge*
-shortest_path(State* state, uint32_t from, uint32_t to, bool use_options)
+namespace {
+
+/** rivers from node back to root of search, in that order */
+void
+append_path(State* state, const SearchSpace& search, uint32_t root, uint32_t node,
+            std::vector<Edge*>* path)
+{
+    while (node != root) {
+        Edge* e = state->get_edge_by_ref(search.parent_ref(node));
+        path->push_back(e);
+        node = e->target != node ? e->target: e->source;
+    }
+}
+
+bool
+can_travel(const Edge* e, uint32_t opt_num)
 {
-    std::queue<uint32_t> queue;
-    std::unordered_map<uint32_t, uint32_t> visited;
+    return e->can_pass() || (e->can_exec_opt() && opt_num > 0);
+}
+
+/** same from the state's edge bits, for the inner loop of searches */
+bool
+can_travel(const State* state, uint32_t edge_id, uint32_t opt_num)
+{
+    return state->can_pass(edge_id) || (opt_num > 0 && state->can_buy_option(edge_id));
+}
+
+}
+
+bool
+shortest_path_bfs(State* state, uint32_t from, uint32_t to, bool use_options, Deadline* deadline,
+                  std::vector<Edge*>* path, unsigned slot, size_t* visited)
+{
+    SearchSpace* search = state->new_search(slot);
+    path->clear();
 
     uint32_t opt_num = use_options ? state->get_header()->options_avail : 0;
-    std::cerr << "OPTIONS LEFT: " << opt_num << std::endl;
-    queue.push(from);
-    visited.emplace(from, UNDEFINED);
-    while(!queue.empty()) {
-        uint32_t node = queue.front();
-        queue.pop();
+    search->push(from);
+    search->visit(from, UNDEFINED);
+    bool found = false;
+    while(!search->empty() && !found) {
+        if (deadline->poll()) break;
+        uint32_t node = search->pop_front();
         auto iter = state->get_edges_iter(node);
         for (auto i = iter.first; i < iter.second; ++i) {
-            Edge* e = state->get_edge_by_ref(i);
-            if (e->can_pass() || (e->can_exec_opt() && opt_num >  0)) {
-                // can travel
-                uint32_t t = e->source == node ? e->target: e->source;
-                if (visited.find(t) != visited.end()) continue; // already visited
+            uint32_t edge_id = state->edge_id_by_ref(i);
+            if (!can_travel(state, edge_id, opt_num)) continue;
+            uint32_t t = state->neighbor_by_ref(i);
+            if (search->visited(t)) continue; // already visited
 
-                if(!e->can_pass()) {
-                    std::cerr << "Dec opt: " << opt_num << std::endl;
-                    --opt_num; // exec option
-                }
-                queue.push(t);
-                visited.emplace(t, i);
-                if (t == to) {
-                    // target reached
-                    // unpack path
-                    auto path = unpack_path(state, from, to, visited);
-#ifdef DEBUG
-                    std::cerr << "Path found:" << from << " -> " << to << " ===>  ";
-                    for (auto it = path.rbegin(); it != path.rend(); ++it) {
-                        Edge* eee = *it;
-                        std::cerr << "(" << eee->source << "," << eee->target << "," << eee->claimed << eee->option <<  eee->me << ")";
-                    }
-                    std::cerr << std::endl;
-#endif
-                    for (auto it = path.rbegin(); it != path.rend(); ++it) {
-                        if (!(*it)->claimed_by_me()) {
-                            return *it;
-                        }
-                    }
-                    return *path.rbegin();
-                }
+            if(!state->can_pass(edge_id)) {
+                --opt_num; // exec option
+            }
+            search->push(t);
+            search->visit(t, i);
+            if (t == to) {
+                found = true;
+                break;
+            }
+        }
+    }
+    if (visited != nullptr) *visited = search->pushed();
+    if (!found) return false;
+    append_path(state, *search, from, to, path);
+    std::reverse(path->begin(), path->end());
+    return true;
+}
 
+bool
+shortest_path_bidir(State* state, uint32_t from, uint32_t to, bool use_options, Deadline* deadline,
+                    std::vector<Edge*>* path, unsigned slot, size_t* visited)
+{
+    auto searches = state->new_search_pair(slot);
+    SearchSpace* fwd = searches.first;
+    SearchSpace* bwd = searches.second;
+    path->clear();
+    if (from == to) return false;
+
+    uint32_t opt_num = use_options ? state->get_header()->options_avail : 0;
+    fwd->push(from);
+    fwd->visit(from, UNDEFINED);
+    bwd->push(to);
+    bwd->visit(to, UNDEFINED);
+    // the rivers x-y joining the two trees, x on the forward side
+    uint32_t meet_ref = UNDEFINED, x = UNDEFINED, y = UNDEFINED;
+    while (!fwd->empty() && !bwd->empty() && meet_ref == UNDEFINED) {
+        // grow the smaller frontier by a whole level: the first meeting
+        // then closes a shortest path
+        bool forward = fwd->size() <= bwd->size();
+        SearchSpace* side = forward ? fwd : bwd;
+        SearchSpace* other = forward ? bwd : fwd;
+        for (size_t left = side->size(); left > 0 && meet_ref == UNDEFINED; --left) {
+            if (deadline->poll()) return false;
+            uint32_t node = side->pop_front();
+            auto iter = state->get_edges_iter(node);
+            for (auto i = iter.first; i < iter.second; ++i) {
+                uint32_t edge_id = state->edge_id_by_ref(i);
+                if (!can_travel(state, edge_id, opt_num)) continue;
+                uint32_t t = state->neighbor_by_ref(i);
+                if (other->visited(t)) {
+                    meet_ref = i;
+                    x = forward ? node : t;
+                    y = forward ? t : node;
+                    break;
+                }
+                if (side->visited(t)) continue;
+                if (!state->can_pass(edge_id)) --opt_num;
+                side->push(t);
+                side->visit(t, i);
             }
         }
     }
-    return nullptr;
+    if (visited != nullptr) *visited = fwd->pushed() + bwd->pushed();
+    if (meet_ref == UNDEFINED) return false;
 
+    append_path(state, *fwd, from, x, path);
+    std::reverse(path->begin(), path->end());
+    path->push_back(state->get_edge_by_ref(meet_ref));
+    append_path(state, *bwd, to, y, path);
+    return true;
 }
 
+Edge*
+next_river(const std::vector<Edge*>& path)
+{
+    assert(!path.empty());
+#ifdef DEBUG
+    std::cerr << "Path ===>  ";
+    for (Edge* e: path) {
+        std::cerr << "(" << e->source << "," << e->target << "," << e->claimed << e->option <<  e->me << ")";
+    }
+    std::cerr << std::endl;
+#endif
+    for (Edge* e: path) {
+        if (!e->claimed_by_me()) return e;
+    }
+    return path.front();
+}
+
+bool
+route_is_free(State* state, const std::vector<uint32_t>& route)
+{
+    for (size_t idx = 1; idx < route.size(); ++idx) {
+        Edge* e = state->find_edge(route[idx - 1], route[idx]);
+        if (e == nullptr || e->is_claimed()) return false;
+    }
+    return route.size() > 1;
+}
 
 bool
 connect_mines_move(State* state, proto::Move* move)
@@ -176,8 +274,7 @@ connect_mines_move(State* state, proto::Move* move)
         uint32_t node_id = state->get_mine(i)->site_id;
         std::cerr << "MINE: " << i << ":" << node_id << std::endl;
         assert(state->is_mine(node_id));
-        auto n = unclaimed_edges_from(state, node_id);
-        num_free_edges.emplace_back(n.size(), node_id);
+        num_free_edges.emplace_back(state->frontier_size(node_id), node_id);
     }
 
     std::sort(num_free_edges.begin(), num_free_edges.end());
@@ -206,32 +303,212 @@ connect_mines_move(State* state, proto::Move* move)
     return false;
 }
 
+namespace {
+
+/**
+ * Next river of the cached path of target #t_id, walking it in O(length):
+ * the first one we do not have, the first one if we have all. Nullptr when
+ * there is no path, or it is broken or needs more options than we have.
+ */
+Edge*
+cached_river(State* state, uint32_t t_id)
+{
+    PathRef p = state->target_path(t_id);
+    if (p.length == 0 || p.broken) return nullptr;
+    uint32_t opt_num = state->get_header()->options_avail;
+    Edge* next = nullptr;
+    for (uint32_t i = 0; i < p.length; ++i) {
+        Edge* e = state->get_edge(p.edges[i]);
+        if (e->claimed_by_me()) continue;
+        if (!can_travel(e, opt_num)) return nullptr;
+        if (!e->can_pass()) --opt_num;
+        if (next == nullptr) next = e;
+    }
+    return next != nullptr ? next : state->get_edge(p.edges[0]);
+}
+
+/** rivers of path as ids, dropping the loops splicing may have made */
+void
+simple_path(State* state, uint32_t from, const std::vector<Edge*>& path, unsigned slot,
+            std::vector<uint32_t>* ids)
+{
+    // seen nodes remember their position along the path so far
+    SearchSpace* seen = state->new_search(slot);
+    std::vector<uint32_t> nodes{from};
+    seen->visit(from, 0);
+    ids->clear();
+    for (Edge* e: path) {
+        uint32_t node = nodes.back();
+        uint32_t t = e->source == node ? e->target: e->source;
+        uint32_t pos = seen->visited(t) ? seen->parent_ref(t) : UNDEFINED;
+        if (pos < nodes.size() && nodes[pos] == t) {
+            nodes.resize(pos + 1);
+            ids->resize(pos);
+            continue;
+        }
+        seen->visit(t, nodes.size());
+        nodes.push_back(t);
+        ids->push_back(state->edge_id(e));
+    }
+}
+
+/**
+ * New path for target #t_id into ids. A path broken by other punters is
+ * repaired with a detour around its taken rivers, from the node before the
+ * first one to the node after the last one; a full search is the fallback.
+ */
 bool
-follow_breadcrumbs(State* state, proto::Move* move)
+repair_path(State* state, uint32_t t_id, Deadline* deadline, unsigned slot, std::vector<uint32_t>* ids)
 {
+    Target* t = state->get_target(t_id);
+    PathRef p = state->target_path(t_id);
+    std::vector<Edge*> path, detour;
+    // nodes along the cached path, and the span of rivers we cannot pass
+    uint32_t node = t->source, first_node = UNDEFINED, last_node = UNDEFINED;
+    uint32_t first = UNDEFINED, last = UNDEFINED;
+    for (uint32_t i = 0; i < p.length; ++i) {
+        Edge* e = state->get_edge(p.edges[i]);
+        uint32_t next = e->source == node ? e->target: e->source;
+        if (!e->can_pass()) {
+            if (first == UNDEFINED) {
+                first = i;
+                first_node = node;
+            }
+            last = i;
+            last_node = next;
+        }
+        node = next;
+    }
+    if (first != UNDEFINED && first_node != last_node
+        && shortest_path_bidir(state, first_node, last_node, true, deadline, &detour, slot)) {
+        for (uint32_t i = 0; i < first; ++i) path.push_back(state->get_edge(p.edges[i]));
+        path.insert(path.end(), detour.begin(), detour.end());
+        for (uint32_t i = last + 1; i < p.length; ++i) path.push_back(state->get_edge(p.edges[i]));
+        simple_path(state, t->source, path, slot, ids);
+        // the detour may still take too many options all in all
+        uint32_t opt_num = state->get_header()->options_avail;
+        bool ok = true;
+        for (uint32_t edge_id: *ids) {
+            Edge* e = state->get_edge(edge_id);
+            if (!can_travel(e, opt_num)) ok = false;
+            else if (!e->can_pass()) --opt_num;
+        }
+        if (ok) return true;
+    }
+    if (!shortest_path_bidir(state, t->source, t->target, true, deadline, &path, slot)) return false;
+    simple_path(state, t->source, path, slot, ids);
+    return true;
+}
+
+/**
+ * With splurges on, move claims the first river of a run of free ones on
+ * the path of target #t_id: bank passes until the credit covers the run,
+ * up to kMaxSplurge rivers, then claim it all in one turn. The run is read
+ * off the path every turn and a path that lost a river has been repaired
+ * before we get here; the route is checked all the same before it is sent,
+ * the single claim stands if it is not free.
+ */
+void
+plan_splurge(State* state, uint32_t t_id, proto::Move* move)
+{
+    if (!state->get_header()->has_splurges || move->move_type != proto::CLAIM) return;
+    // rivers before the one claimed are ours, the run starts with it
+    PathRef p = state->target_path(t_id);
+    std::vector<uint32_t> route;
+    uint32_t node = state->get_target(t_id)->source;
+    for (uint32_t i = 0; i < p.length && route.size() <= kMaxSplurge; ++i) {
+        Edge* e = state->get_edge(p.edges[i]);
+        uint32_t next = e->source == node ? e->target: e->source;
+        if (e->is_unclaimed()) {
+            if (route.empty()) route.push_back(node);
+            route.push_back(next);
+        } else if (!route.empty()) {
+            break;
+        }
+        node = next;
+    }
+    if (route.size() < 3) return;
+    uint32_t rivers = route.size() - 1;
+    uint32_t credit = state->get_header()->credit;
+    if (credit + 1 >= rivers) {
+        if (route_is_free(state, route)) *move = state->splurge(route);
+    } else if (state->moves_left() > static_cast<int>(rivers - credit)) {
+        // turns enough left to splurge it all later
+        *move = proto::Move::pass(state->whoami());
+    }
+}
+
+/** move along target t taking edge, or mark it reached; true on a move */
+bool
+take_river(State* state, Target* t, Edge* edge, proto::Move* move)
+{
+    if ( (edge->source == t->source || edge->target == t->source) && edge->claimed_by_me() ) {
+        t->reached = 1;
+        std::cerr << "REACHED: " << t->source << "->" << t->target << std::endl;
+        return false;
+    }
+    assert(!edge->claimed_by_me());
+    if (edge->is_claimed()) {
+        // execute option
+        *move = state->execute_option(edge->source, edge->target);
+    } else {
+        *move = state->claim_edge(edge->source, edge->target);
+    }
+    return true;
+}
 
-    for (size_t idx = 0; idx < state->num_targets(); ++idx) {
+}
+
+bool
+follow_breadcrumbs(State* state, proto::Move* move, Deadline* deadline)
+{
+    std::cerr << "OPTIONS LEFT: " << state->get_header()->options_avail << std::endl;
+    for (uint32_t idx = 0; idx < state->num_targets(); ++idx) {
         Target* t = state->get_target(idx);
         std::cerr << idx << ": TARGETS :" << t->source << "->" << t->target << ", reached: " << t->is_reached() << std::endl;
-        if (!t->is_reached()) {
-            Edge* edge = shortest_path(state, t->source, t->target, true);
-//            if (edge == nullptr) {
-//                edge = shortest_path(state, t->source, t->target, true);
-//            }
-            if (edge != nullptr) {
-                if ( (edge->source == t->source || edge->target == t->source) && edge->claimed_by_me() ) {
-                    t->reached = 1;
-                    std::cerr << "REACHED: " << t->source << "->" << t->target << std::endl;
-                } else {
-                    assert(!edge->claimed_by_me());
-                    if (edge->is_claimed()) {
-                        // execute option
-                        *move = state->execute_option(edge->source, edge->target);
-                    } else {
-                        *move = state->claim_edge(edge->source, edge->target);
-                    }
+    }
+
+    // targets go in order: cached paths answer right away, targets without
+    // a usable one are searched a batch at a time in parallel, up to the
+    // first target after them the cache answers
+    size_t batch = thread_pool().size();
+    std::vector<uint32_t> pending;
+    std::vector<std::vector<uint32_t>> ids(batch);
+    std::vector<char> found(batch);
+    while (true) {
+        pending.clear();
+        for (uint32_t idx = 0; idx < state->num_targets() && pending.size() < batch; ++idx) {
+            Target* t = state->get_target(idx);
+            if (t->is_reached()) continue;
+            Edge* edge = cached_river(state, idx);
+            if (edge == nullptr) {
+                pending.push_back(idx);
+            } else if (!pending.empty()) {
+                break;
+            } else if (take_river(state, t, edge, move)) {
+                plan_splurge(state, idx, move);
+                return true;
+            }
+        }
+        if (pending.empty()) return false;
+
+        thread_pool().parallel_tasks(pending.size(), [&](size_t k, unsigned slot) {
+            Deadline local = deadline->for_thread();
+            found[k] = repair_path(state, pending[k], &local, slot, &ids[k]);
+        });
+        for (size_t k = 0; k < pending.size(); ++k) {
+            Target* t = state->get_target(pending[k]);
+            if (found[k]) {
+                state->set_target_path(pending[k], ids[k]);
+                std::vector<Edge*> path;
+                for (uint32_t edge_id: ids[k]) path.push_back(state->get_edge(edge_id));
+                if (take_river(state, t, next_river(path), move)) {
+                    plan_splurge(state, pending[k], move);
                     return true;
                 }
+            } else if (deadline->expired()) {
+                // search gave up, the target may well be reachable
+                return false;
             } else {
                 // unreachable
                 std::cerr << "UNREACHABLE: " << t->source << "->" << t->target << std::endl;
@@ -239,7 +516,6 @@ follow_breadcrumbs(State* state, proto::Move* move)
             }
         }
     }
-    return false;
 }
 
 bool
@@ -249,7 +525,6 @@ random_move(State* state, proto::Move* move)
         Edge* e = state->get_edge(i);
         if (!e->is_claimed()) {
             // claim this edge
-            std::cerr << "Claiming random" << std::endl;
             *move = state->claim_edge(e->source, e->target);
             return true;
         }
@@ -257,10 +532,92 @@ random_move(State* state, proto::Move* move)
     return false;
 }
 
+/**
+ * Up to n free rivers adding the most to our score right away, best first:
+ * dist^2 from the mines on one side to the node on the other. Best seen so
+ * far at the deadline.
+ */
+void
+greedy_rivers(State* state, size_t n, Deadline* deadline, std::vector<Edge*>* best)
+{
+    best->clear();
+    // the table comes with the state once setup built it, nothing to offer
+    // on maps without one
+    if (!state->build_distances(deadline)) return;
+    std::vector<uint32_t> mine_root(state->num_mines());
+    for (uint32_t m = 0; m < state->num_mines(); ++m) {
+        mine_root[m] = state->component(state->get_mine(m)->site_id);
+    }
+
+    std::vector<std::pair<uint64_t, Edge*>> top;
+    for (uint32_t i = 0; i < state->num_edges() && !deadline->poll(); ++i) {
+        Edge* e = state->get_edge(i);
+        if (e->is_claimed()) continue;
+        uint32_t ca = state->component(e->source);
+        uint32_t cb = state->component(e->target);
+        uint64_t gain = 0;
+        for (uint32_t m = 0; m < mine_root.size(); ++m) {
+            uint64_t d = 0;
+            if (mine_root[m] == ca) d = state->mine_distance(m, e->target);
+            else if (mine_root[m] == cb) d = state->mine_distance(m, e->source);
+            gain += d * d;
+        }
+        if (gain == 0 || (top.size() == n && gain <= top.back().first)) continue;
+        if (top.size() == n) top.pop_back();
+        auto pos = std::upper_bound(top.begin(), top.end(), gain,
+                                    [](uint64_t g, const std::pair<uint64_t, Edge*>& t) { return g > t.first; });
+        top.emplace(pos, gain, e);
+    }
+    for (const auto& t: top) best->push_back(t.second);
+}
+
+/**
+ * Of the best greedy rivers, the one with the highest mean score over
+ * random playouts. The greedy pick stands when there is no time for them.
+ */
 bool
-make_move(State* state, proto::Move* move)
+rollout_move(State* state, proto::Move* move, Deadline* deadline)
 {
+    std::vector<Edge*> candidates;
+    greedy_rivers(state, kRolloutCandidates, deadline, &candidates);
+    if (candidates.empty()) return false;
+    *move = state->claim_edge(candidates[0]->source, candidates[0]->target);
+    if (candidates.size() == 1 || deadline->expired()) return true;
 
-    return follow_breadcrumbs(state, move)
-        || random_move(state, move);
+    std::vector<uint32_t> ids;
+    for (Edge* e: candidates) ids.push_back(state->edge_id(e));
+    std::vector<double> mean;
+    Rollouts rollouts(state);
+    uint32_t playouts = rollouts.evaluate(ids, kMaxPlayouts, deadline, &mean);
+    if (playouts == 0) return true;
+    size_t pick = std::max_element(mean.begin(), mean.end()) - mean.begin();
+    std::cerr << "Rollouts: " << playouts << " per river, greedy " << mean[0]
+              << ", picked " << mean[pick] << std::endl;
+    *move = state->claim_edge(candidates[pick]->source, candidates[pick]->target);
+    return true;
+}
+
+bool
+make_move(State* state, proto::Move* move, Deadline* deadline)
+{
+    // cheap fallback first, so that there is an answer however early the
+    // deadline hits; candidates further down only replace it when complete
+    if (!random_move(state, move)) return false;
+
+    proto::Move candidate;
+    if (follow_breadcrumbs(state, &candidate, deadline)
+        || rollout_move(state, &candidate, deadline)) {
+        *move = candidate;
+    } else {
+        std::cerr << "Claiming random" << std::endl;
+    }
+    if (deadline->expired()) std::cerr << "Out of time" << std::endl;
+    return true;
+}
+
+bool
+make_move(State* state, proto::Move* move)
+{
+    Deadline unlimited;
+    return make_move(state, move, &unlimited);
 }
@@ -1,6 +1,28 @@
 #pragma once
 
+#include "deadline.h"
 #include "state.h"
 #include "protocol.h"
 
 bool make_move(State* state, proto::Move* move);
+
+/**
+ * Shortest path from..to in that order over rivers we can pass, or buy an
+ * option on while use_options and options last. False when there is none
+ * or the deadline passed; visited gets the number of nodes queued.
+ */
+bool shortest_path_bfs(State* state, uint32_t from, uint32_t to, bool use_options, Deadline* deadline,
+                       std::vector<Edge*>* path, unsigned slot = 0, size_t* visited = nullptr);
+
+/** same, searching from both ends */
+bool shortest_path_bidir(State* state, uint32_t from, uint32_t to, bool use_options, Deadline* deadline,
+                         std::vector<Edge*>* path, unsigned slot = 0, size_t* visited = nullptr);
+
+/** first river of path we do not have yet, the first one if we have all */
+Edge* next_river(const std::vector<Edge*>& path);
+
+/** true when every river along route, a list of nodes, is there and free */
+bool route_is_free(State* state, const std::vector<uint32_t>& route);
+
+/** best move found before the deadline */
+bool make_move(State* state, proto::Move* move, Deadline* deadline);
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <stdint.h>
+
+/**
+ * Site ids as the server sends them to our dense node ids. A plain table
+ * when the ids are about as dense as the nodes, which is the usual case;
+ * sorted pairs and a binary search when they are sparse.
+ */
+class IdMap {
+public:
+    /** ids[node] is the server's id of node, distinct */
+    void build(const uint32_t* ids, uint32_t n) {
+        clear();
+        uint32_t max_id = 0;
+        for (uint32_t node = 0; node < n; ++node) max_id = std::max(max_id, ids[node]);
+        if (n > 0 && max_id / 2 <= n + 1024) {
+            table.assign(static_cast<size_t>(max_id) + 1, kMissing);
+            for (uint32_t node = 0; node < n; ++node) table[ids[node]] = node;
+        } else {
+            sorted.reserve(n);
+            for (uint32_t node = 0; node < n; ++node) sorted.emplace_back(ids[node], node);
+            std::sort(sorted.begin(), sorted.end());
+        }
+        built = true;
+    }
+
+    void clear() {
+        table.clear();
+        sorted.clear();
+        built = false;
+    }
+
+    bool empty() const { return !built; }
+
+    /** node of the server's id, false for an id that is not there */
+    bool find(uint32_t id, uint32_t* node) const {
+        if (!table.empty()) {
+            if (id >= table.size() || table[id] == kMissing) return false;
+            *node = table[id];
+            return true;
+        }
+        auto it = std::lower_bound(sorted.begin(), sorted.end(), std::make_pair(id, 0u));
+        if (it == sorted.end() || it->first != id) return false;
+        *node = it->second;
+        return true;
+    }
+
+private:
+    enum : uint32_t { kMissing = 0xffffffff };
+
+    std::vector<uint32_t> table;
+    std::vector<std::pair<uint32_t, uint32_t>> sorted;
+    bool built = false;
+};
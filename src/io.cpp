@@ -1,12 +1,91 @@
 #include "io.h"
 
-#include <stdio.h>
-#include <cassert>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <algorithm>
 #include <iostream>
-#include <sstream>
 
 namespace io {
 
+namespace {
+
+int in_fd = 0;
+int out_fd = 1;
+
+/** input read ahead of the current message, in practice only its prefix */
+struct ReadBuffer {
+    char data[4096];
+    size_t pos = 0;
+    size_t end = 0;
+};
+
+ReadBuffer rbuf;
+
+/** read(2) retrying on EINTR, exit on EOF or error */
+size_t
+read_some(char* buf, size_t sz)
+{
+    while (true) {
+        ssize_t n = read(in_fd, buf, sz);
+        if (n > 0) return n;
+        if (n < 0 && errno == EINTR) continue;
+        std::cerr << "Input closed: " << (n == 0 ? "EOF" : strerror(errno)) << std::endl;
+        exit(1);
+    }
+}
+
+char
+next_char()
+{
+    if (rbuf.pos == rbuf.end) {
+        rbuf.pos = 0;
+        rbuf.end = read_some(rbuf.data, sizeof(rbuf.data));
+    }
+    return rbuf.data[rbuf.pos++];
+}
+
+}
+
+bool
+connect(const std::string& host, int port)
+{
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* addrs = nullptr;
+    int err = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addrs);
+    if (err != 0) {
+        std::cerr << "Can't resolve " << host << ": " << gai_strerror(err) << std::endl;
+        return false;
+    }
+    int fd = -1;
+    for (struct addrinfo* a = addrs; a != nullptr && fd < 0; a = a->ai_next) {
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd >= 0 && ::connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(addrs);
+    if (fd < 0) {
+        std::cerr << "Can't connect to " << host << ":" << port << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    // replies are small and latency bound
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    in_fd = out_fd = fd;
+    return true;
+}
+
 void
 send(const std::string& msg)
 {
@@ -14,36 +93,66 @@ send(const std::string& msg)
 //    std::cerr << "Sending " << msg.size() << " bytes" << std::endl;
 //    std::cerr << msg.size() << ":" << msg << std::endl;
 #endif
-    std::cout << msg.size() << ":" << msg << std::flush;
+    std::string prefix = std::to_string(msg.size()) + ":";
+    struct iovec iov[2];
+    iov[0].iov_base = const_cast<char*>(prefix.data());
+    iov[0].iov_len = prefix.size();
+    iov[1].iov_base = const_cast<char*>(msg.data());
+    iov[1].iov_len = msg.size();
+
+    int idx = 0;
+    while (idx < 2) {
+        ssize_t n = writev(out_fd, iov + idx, 2 - idx);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Write failed: " << strerror(errno) << std::endl;
+            exit(1);
+        }
+        // advance past what was written, short writes are possible on pipes
+        size_t written = n;
+        while (idx < 2 && written >= iov[idx].iov_len) {
+            written -= iov[idx].iov_len;
+            ++idx;
+        }
+        if (idx < 2) {
+            iov[idx].iov_base = static_cast<char*>(iov[idx].iov_base) + written;
+            iov[idx].iov_len -= written;
+        }
+    }
 }
 
 std::string
 receive()
+{
+    std::string msg;
+    receive(&msg);
+    return msg;
+}
+
+void
+receive(std::string* msg)
 {
     char buf[16];
     size_t idx = 0;
 
-    char ch;
-    do {
-        ch = getchar();
-    } while(ch == EOF);
-
+    char ch = next_char();
     while(ch != ':' && idx < 10) {
         buf[idx++] = ch;
-        ch = getchar();
+        ch = next_char();
     }
     buf[idx] = 0;
-    int sz = atoi(buf);
+    size_t sz = strtoul(buf, nullptr, 10);
     std::cerr << "Reading " << sz << " bytes" << std::endl;
-    std::stringstream ss;
-    for (int i =0; i < sz; ++i) {
-        ch = getchar();
-        assert(ch != EOF);
-        ss << ch;
-    }
 
-    return ss.str();
+    msg->resize(sz);
+    char* out = &(*msg)[0];
+    size_t have = std::min(sz, rbuf.end - rbuf.pos);
+    memcpy(out, rbuf.data + rbuf.pos, have);
+    rbuf.pos += have;
+    // the rest goes straight into the message
+    while (have < sz) {
+        have += read_some(out + have, sz - have);
+    }
 }
 
-
 }
@@ -4,8 +4,15 @@
 
 namespace io {
 
+/** talk over a TCP connection instead of stdin/stdout, false on failure */
+bool connect(const std::string& host, int port);
+
+/** write length-prefixed message with a single writev */
 void send(const std::string& msg);
 
 std::string receive();
 
+/** read next message into msg, reusing its capacity */
+void receive(std::string* msg);
+
 }
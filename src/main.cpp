@@ -1,7 +1,10 @@
 #include <iostream>
+#include <memory>
 #include <string>
 #include <cassert>
 #include <chrono>
+#include <stdlib.h>
+#include <string.h>
 #include "io.h"
 #include "protocol.h"
 #include "state.h"
@@ -10,6 +13,13 @@
 
 const char* PUNTER_NAME = "poopybutthole";
 
+// the server allows 10 s for setup and 1 s per move, counting our process
+// start; keep the rest for serializing the state and sending the reply
+const double SETUP_BUDGET = 8.0;
+const double MOVE_BUDGET = 0.75;
+
+const auto process_start = Deadline::Clock::now();
+
 namespace json = picojson;
 
 void
@@ -21,35 +31,46 @@ handshake()
 }
 
 void
-setup(const json::value::object& root )
+setup(const std::string& raw)
 {
     // start timer for setup
     // const auto start = std::chrono::high_resolution_clock::now();
-    auto setup = proto::read_setup(root);
+    Deadline deadline(process_start, SETUP_BUDGET);
+    proto::SetupView setup(raw);
     State state(setup);
 
-    auto futures = state.init_execution_plan();
+    auto futures = state.init_execution_plan(&deadline);
 
-    io::send(proto::write_punter_ready(setup.punter, futures, state.serialize()));
+    std::string msg;
+    proto::write_punter_ready(setup.punter, futures, [&](std::string* out) { state.serialize(out); }, &msg);
+    io::send(msg);
 }
 
 void
-gameplay(const json::value::object& root )
+gameplay(std::string* raw)
 {
     proto::Moves moves;
-    read_moves(root, &moves);
-    State game_state(root.at("state").get<std::string>());
+    proto::Slice state;
+    proto::read_moves(raw, &moves, &state);
+    State game_state(state.data, state.size);
     std::cerr << "MOVES LEFT: " << game_state.moves_left() << std::endl;
     game_state.update(moves);
 
     proto::Move move;
-    make_move(&game_state, &move);
-    io::send(proto::write_move(move, game_state.serialize()));
+    Deadline deadline(process_start, MOVE_BUDGET);
+    make_move(&game_state, &move, &deadline);
+    std::string msg;
+    proto::write_move(move, [&](std::string* out) { game_state.serialize(out); }, &msg);
+    io::send(msg);
 }
 
 void
-scoring(const json::value::object& root )
+scoring(const std::string& raw)
 {
+    json::value jsn;
+    std::string err = json::parse(jsn, raw);
+    assert(err.empty());
+    const auto& root = jsn.get<json::object>();
     // print scores
     std::cerr << "Final scores:" << std::endl;
     for (const auto& elem: root.at("stop").get<json::object>().at("scores").get<json::array>()) {
@@ -60,35 +81,84 @@ scoring(const json::value::object& root )
     }
 }
 
+/** online protocol: one process per game, state stays in memory */
+int
+online(const std::string& host, int port)
+{
+    if (!io::connect(host, port)) return 1;
+    handshake();
+
+    std::unique_ptr<State> state;
+    std::string raw, msg;
+    proto::Moves moves;
+    while (true) {
+        io::receive(&raw);
+        auto start_time = Deadline::Clock::now();
+        auto type = proto::message_type(raw);
+        if (type == proto::SETUP) {
+            Deadline deadline(start_time, SETUP_BUDGET);
+            proto::SetupView setup(raw);
+            state.reset(new State(setup));
+            auto futures = state->init_execution_plan(&deadline);
+            proto::write_punter_ready(setup.punter, futures, nullptr, &msg);
+        } else if (type == proto::MOVE) {
+            assert(state);
+            proto::Slice unused;
+            proto::read_moves(&raw, &moves, &unused);
+            std::cerr << "MOVES LEFT: " << state->moves_left() << std::endl;
+            state->update(moves);
+            proto::Move move;
+            Deadline deadline(start_time, MOVE_BUDGET);
+            make_move(state.get(), &move, &deadline);
+            proto::write_move(move, nullptr, &msg);
+        } else if (type == proto::STOP) {
+            scoring(raw);
+            return 0;
+        } else if (type == proto::TIMEOUT) {
+            std::cerr << "Timeout" << std::endl;
+            continue;
+        } else {
+            std::cerr << "Unknown game state: " << raw << std::endl;
+            return 1;
+        }
+        io::send(msg);
+        auto current_time = Deadline::Clock::now();
+        std::cerr << "Elapsed: " << std::chrono::duration_cast<std::chrono::microseconds>(current_time - start_time).count() << " microseconds" << std::endl;
+    }
+}
+
 int
-main()
+main(int argc, char** argv)
 {
+    if (argc == 4 && strcmp(argv[1], "--online") == 0) {
+        return online(argv[2], atoi(argv[3]));
+    }
+    if (argc != 1) {
+        std::cerr << "usage: punter [--online host port]" << std::endl;
+        return 1;
+    }
+
     std::cerr << "===BEGIN===" << std::endl;
     handshake();
-    auto start_time = std::chrono::high_resolution_clock::now();
+    auto start_time = Deadline::Clock::now();
 
     auto raw = io::receive();
-    json::value jsn;
-    std::string err = json::parse(jsn, raw);
-    if(!err.empty()) {
-        std::cerr << raw << std::endl;
-        std::cerr << err << std::endl;
-        assert(err.empty());
-    }
-    const auto& root = jsn.get<json::object>();
-    if (root.find("map") != root.end()) {
-        setup(root);
-    } else if (root.find("move") != root.end()) {
-        gameplay(root);
-    } else if (root.find("stop") != root.end()) {
-        scoring(root);
-    } else if (root.find("timeout") != root.end()) {
-        std::cerr << "Timeout: "<< root.at("timeout").get<double>() << std::endl;
+    auto type = proto::message_type(raw);
+    if (type == proto::SETUP) {
+        // the map can be huge, build state straight from the text
+        setup(raw);
+    } else if (type == proto::MOVE) {
+        // so can be the state, decode it right from the receive buffer
+        gameplay(&raw);
+    } else if (type == proto::STOP) {
+        scoring(raw);
+    } else if (type == proto::TIMEOUT) {
+        std::cerr << "Timeout" << std::endl;
     } else {
         std::cerr << "Unknown game state: " << raw << std::endl;
         exit(1);
     }
-    auto current_time = std::chrono::high_resolution_clock::now();
+    auto current_time = Deadline::Clock::now();
     std::cerr << "Elapsed: " << std::chrono::duration_cast<std::chrono::microseconds>(current_time - start_time).count() << " microseconds" << std::endl;
     std::cerr << "=== END ===" << std::endl;
     return 0;
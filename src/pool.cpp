@@ -0,0 +1,143 @@
+#include "pool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdlib.h>
+
+namespace {
+
+uint64_t
+pack(uint32_t begin, uint32_t end)
+{
+    return static_cast<uint64_t>(begin) << 32 | end;
+}
+
+}
+
+ThreadPool::ThreadPool(unsigned threads):slices(new Slice[std::max(threads, 1u)])
+{
+    for (unsigned idx = 1; idx < threads; ++idx) {
+        workers.emplace_back([this, idx]() { worker(idx); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& t: workers) t.join();
+}
+
+bool
+ThreadPool::take(unsigned slot, size_t* idx)
+{
+    unsigned slots = size();
+    while (true) {
+        uint64_t own = slices[slot].bounds.load();
+        uint32_t begin = own >> 32, end = static_cast<uint32_t>(own);
+        if (begin < end) {
+            if (slices[slot].bounds.compare_exchange_weak(own, pack(begin + 1, end))) {
+                *idx = begin;
+                return true;
+            }
+            continue;
+        }
+        // own slice is empty, steal the back half of somebody else's; ids
+        // are handed out once, so a stale slice can never compare equal
+        bool left = false;
+        for (unsigned k = 1; k < slots; ++k) {
+            unsigned victim = (slot + k) % slots;
+            uint64_t other = slices[victim].bounds.load();
+            uint32_t vbegin = other >> 32, vend = static_cast<uint32_t>(other);
+            if (vbegin >= vend) continue;
+            left = true;
+            uint32_t half = (vend - vbegin + 1) / 2;
+            if (slices[victim].bounds.compare_exchange_strong(other, pack(vbegin, vend - half))) {
+                *idx = vend - half;
+                slices[slot].bounds.store(pack(vend - half + 1, vend));
+                return true;
+            }
+            break;
+        }
+        if (!left) return false;
+    }
+}
+
+void
+ThreadPool::run_job(const Task& fn, unsigned slot)
+{
+    size_t idx;
+    while (take(slot, &idx)) {
+        fn(idx, slot);
+        ++finished;
+    }
+}
+
+void
+ThreadPool::worker(unsigned slot)
+{
+    uint64_t seen = 0;
+    while (true) {
+        const Task* fn;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&]() { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+            // woke up after the caller already finished the job alone
+            if (job == nullptr) continue;
+            fn = job;
+            ++busy;
+        }
+        run_job(*fn, slot);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --busy;
+        }
+        done.notify_all();
+    }
+}
+
+void
+ThreadPool::parallel_for(size_t n, const std::function<void(size_t)>& fn)
+{
+    parallel_tasks(n, [&](size_t idx, unsigned) { fn(idx); });
+}
+
+void
+ThreadPool::parallel_tasks(size_t n, const Task& fn)
+{
+    if (workers.empty() || n <= 1) {
+        for (size_t idx = 0; idx < n; ++idx) fn(idx, 0);
+        return;
+    }
+    assert(n < (1ull << 32));
+    unsigned slots = size();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (unsigned slot = 0; slot < slots; ++slot) {
+            slices[slot].bounds.store(pack(n * slot / slots, n * (slot + 1) / slots));
+        }
+        job = &fn;
+        finished = 0;
+        ++generation;
+    }
+    wake.notify_all();
+    run_job(fn, 0);
+    // wait for the stragglers, and for every worker to let go of the job
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&]() { return finished == n && busy == 0; });
+    job = nullptr;
+}
+
+ThreadPool&
+thread_pool()
+{
+    // PUNTER_THREADS overrides the number of cores, e.g. on a shared box
+    const char* env = getenv("PUNTER_THREADS");
+    static ThreadPool pool(env != nullptr && atoi(env) > 0 ? atoi(env) : std::thread::hardware_concurrency());
+    return pool;
+}
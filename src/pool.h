@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed set of worker threads running index ranges in parallel.
+ * The calling thread takes part in the work, so a pool of one thread
+ * runs everything inline.
+ *
+ * Every thread starts on its own slice of the range and takes tasks from
+ * its front; a thread out of work steals the back half of the slice of
+ * another, so uneven tasks still keep everybody busy.
+ */
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threads = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    unsigned size() const { return workers.size() + 1; }
+
+    /** run fn(idx) for idx in [0, n), return when all calls finished */
+    void parallel_for(size_t n, const std::function<void(size_t)>& fn);
+
+    /**
+     * Same, fn(idx, slot) also gets the slot in [0, size()) of the thread
+     * running it, to pick per-thread scratch. The caller is slot 0.
+     */
+    void parallel_tasks(size_t n, const std::function<void(size_t, unsigned)>& fn);
+
+private:
+    typedef std::function<void(size_t, unsigned)> Task;
+
+    // [begin, end) of the task ids of a slot, begin in the high word;
+    // padded so that slots do not share a cache line
+    struct Slice {
+        std::atomic<uint64_t> bounds{0};
+        char pad[56];
+    };
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    std::unique_ptr<Slice[]> slices;
+
+    // current job, guarded by mutex except for the slices and the counter
+    const Task* job = nullptr;
+    uint64_t generation = 0;
+    std::atomic<size_t> finished{0};
+    unsigned busy = 0;
+    bool stopping = false;
+
+    void worker(unsigned slot);
+    void run_job(const Task& fn, unsigned slot);
+    /** next task for slot, its own or stolen; false when none are left */
+    bool take(unsigned slot, size_t* idx);
+};
+
+/** process wide pool, one thread per core or PUNTER_THREADS */
+ThreadPool& thread_pool();
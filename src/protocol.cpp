@@ -2,6 +2,8 @@
 
 #include <string>
 #include <assert.h>
+#include <string.h>
+#include <stdlib.h>
 
 #include "picojson/picojson.h"
 
@@ -74,24 +76,99 @@ read_setup(const json::value::object& root)
     return result;
 }
 
+MessageType
+message_type(const std::string& raw)
+{
+    JsonScanner s(raw.data(), raw.data() + raw.size());
+    s.expect('{');
+    while (s.next_key()) {
+        if (s.key_is("map")) return SETUP;
+        if (s.key_is("move")) return MOVE;
+        if (s.key_is("stop")) return STOP;
+        if (s.key_is("timeout")) return TIMEOUT;
+        s.skip_value();
+    }
+    return UNKNOWN;
+}
+
+SetupView::SetupView(const std::string& raw):
+    punter(0), punters(0), has_futures(false), has_splurges(false), has_options(false),
+    sites(nullptr), rivers(nullptr), end(raw.data() + raw.size())
+{
+    std::cerr << "Scanning setup" << std::endl;
+    JsonScanner s(raw.data(), end);
+    s.expect('{');
+    while (s.next_key()) {
+        if (s.key_is("punter")) {
+            punter = s.integer();
+        } else if (s.key_is("punters")) {
+            punters = s.integer();
+        } else if (s.key_is("settings")) {
+            s.expect('{');
+            while (s.next_key()) {
+                if (s.key_is("futures")) has_futures = s.boolean();
+                else if (s.key_is("splurges")) has_splurges = s.boolean();
+                else if (s.key_is("options")) has_options = s.boolean();
+                else s.skip_value();
+            }
+        } else if (s.key_is("map")) {
+            s.expect('{');
+            while (s.next_key()) {
+                // remember where the big arrays start, scan them later
+                s.ws();
+                if (s.key_is("sites")) {
+                    sites = s.position();
+                    s.skip_value();
+                } else if (s.key_is("rivers")) {
+                    rivers = s.position();
+                    s.skip_value();
+                } else if (s.key_is("mines")) {
+                    s.expect('[');
+                    while (s.next_item()) mines.push_back(s.integer());
+                } else {
+                    s.skip_value();
+                }
+            }
+        } else {
+            s.skip_value();
+        }
+    }
+    assert(sites != nullptr && rivers != nullptr);
+}
+
 std::string
 write_punter_ready(int punter, const std::vector<Future>& futures, const std::string& state)
 {
-    json::value v;
-    v.set<json::object>(json::object());
-    v.get<json::object>()["ready"] = json::value(static_cast<double>(punter));
-    v.get<json::object>()["state"] = json::value(state);
+    std::string out;
+    write_punter_ready(punter, futures, [&](std::string* o) { o->append(state); }, &out);
+    return out;
+}
+
+void
+write_punter_ready(int punter, const std::vector<Future>& futures, const AppendState& state,
+                   std::string* out)
+{
+    out->clear();
+    *out += "{\"ready\":";
+    *out += std::to_string(punter);
     if (!futures.empty()) {
-        json::value::array futures_val;
-        for (const auto& f: futures) {
-            json::value::object m;
-            m["source"] = json::value(static_cast<double>(f.source));
-            m["target"] = json::value(static_cast<double>(f.target));
-            futures_val.push_back(json::value(m));
+        *out += ",\"futures\":[";
+        for (size_t idx = 0; idx < futures.size(); ++idx) {
+            if (idx > 0) *out += ',';
+            *out += "{\"source\":";
+            *out += std::to_string(futures[idx].source);
+            *out += ",\"target\":";
+            *out += std::to_string(futures[idx].target);
+            *out += '}';
         }
-        v.get<json::object>()["futures"] = json::value(futures_val);
+        *out += ']';
     }
-    return v.serialize();
+    if (state) {
+        *out += ",\"state\":\"";
+        state(out);
+        *out += '"';
+    }
+    *out += '}';
 }
 
 void
@@ -137,37 +214,164 @@ read_moves(const json::value::object& root, Moves* moves)
     }
 }
 
+namespace {
+
+/** unescape JSON string contents in place, return new length */
+size_t
+unescape(char* s, size_t len)
+{
+    size_t out = 0;
+    for (size_t i = 0; i < len; ++i) {
+        if (s[i] != '\\') {
+            s[out++] = s[i];
+            continue;
+        }
+        assert(i + 1 < len);
+        char c = s[++i];
+        switch (c) {
+        case 'b': s[out++] = '\b'; break;
+        case 'f': s[out++] = '\f'; break;
+        case 'n': s[out++] = '\n'; break;
+        case 'r': s[out++] = '\r'; break;
+        case 't': s[out++] = '\t'; break;
+        case 'u': {
+            // only ASCII can show up in base64 text
+            assert(i + 4 < len);
+            s[out++] = static_cast<char>(strtol(std::string(s + i + 1, 4).c_str(), nullptr, 16));
+            i += 4;
+            break;
+        }
+        default: s[out++] = c; break;
+        }
+    }
+    return out;
+}
+
+/** {"punter": p, "source": s, "target": t, "route": [...]} */
+void
+scan_move_body(JsonScanner* s, int* punter, int* source, int* target, std::vector<int>* route)
+{
+    s->expect('{');
+    while (s->next_key()) {
+        if (s->key_is("punter")) *punter = s->integer();
+        else if (s->key_is("source")) *source = s->integer();
+        else if (s->key_is("target")) *target = s->integer();
+        else if (s->key_is("route")) {
+            s->expect('[');
+            while (s->next_item()) route->push_back(s->integer());
+        } else {
+            s->skip_value();
+        }
+    }
+}
+
+}
+
+void
+read_moves(std::string* raw, Moves* moves, Slice* state)
+{
+    moves->resize(0);
+    state->data = nullptr;
+    state->size = 0;
+    std::vector<int> route;
+    JsonScanner s(raw->data(), raw->data() + raw->size());
+    s.expect('{');
+    while (s.next_key()) {
+        if (s.key_is("state")) {
+            s.string(&state->data, &state->size);
+            char* begin = &(*raw)[state->data - raw->data()];
+            if (memchr(begin, '\\', state->size) != nullptr) {
+                state->size = unescape(begin, state->size);
+            }
+        } else if (s.key_is("move")) {
+            s.expect('{');
+            while (s.next_key()) {
+                if (!s.key_is("moves")) {
+                    s.skip_value();
+                    continue;
+                }
+                s.expect('[');
+                while (s.next_item()) {
+                    s.expect('{');
+                    while (s.next_key()) {
+                        int punter = -1, source = -1, target = -1;
+                        route.resize(0);
+                        if (s.key_is("pass")) {
+                            scan_move_body(&s, &punter, &source, &target, &route);
+                            moves->push_back(Move::pass(punter));
+                        } else if (s.key_is("claim")) {
+                            scan_move_body(&s, &punter, &source, &target, &route);
+                            moves->push_back(Move::claim(punter, source, target));
+                        } else if (s.key_is("splurge")) {
+                            // convert splurge to series of claim
+                            scan_move_body(&s, &punter, &source, &target, &route);
+                            for (size_t idx = 1; idx < route.size(); ++idx) {
+                                moves->push_back(Move::claim(punter, route[idx - 1], route[idx]));
+                            }
+                        } else if (s.key_is("option")) {
+                            scan_move_body(&s, &punter, &source, &target, &route);
+                            moves->push_back(Move::option(punter, source, target));
+                        } else {
+                            std::cerr << "Unknown move type" << std::endl;
+                            assert(false);
+                            s.skip_value();
+                        }
+                    }
+                }
+            }
+        } else {
+            s.skip_value();
+        }
+    }
+}
+
 std::string
 write_move(const proto::Move& move, const std::string& state)
 {
-    json::value v;
-    v.set<json::object>(json::object());
-    json::value::object m;
-    m["punter"] = json::value(static_cast<double>(move.punter));
+    std::string out;
+    write_move(move, [&](std::string* o) { o->append(state); }, &out);
+    return out;
+}
+
+void
+write_move(const proto::Move& move, const AppendState& state, std::string* out)
+{
+    out->clear();
     switch(move.move_type){
-    case CLAIM: {
-        m["source"] = json::value(static_cast<double>(move.source));
-        m["target"] = json::value(static_cast<double>(move.target));
-        v.get<json::object>()["claim"] = json::value(m);
+    case CLAIM:
+        *out += "{\"claim\":{\"punter\":";
         break;
-    }
-    case PASS:{
-        v.get<json::object>()["pass"] = json::value(m);
+    case PASS:
+        *out += "{\"pass\":{\"punter\":";
         break;
-    }
-    case SPLURGE: {
-        v.get<json::object>()["pass"] = json::value(m);
+    case SPLURGE:
+        *out += "{\"splurge\":{\"punter\":";
         break;
-    }
-    case OPTION: {
-        m["source"] = json::value(static_cast<double>(move.source));
-        m["target"] = json::value(static_cast<double>(move.target));
-        v.get<json::object>()["option"] = json::value(m);
+    case OPTION:
+        *out += "{\"option\":{\"punter\":";
         break;
     }
+    *out += std::to_string(move.punter);
+    if (move.move_type == CLAIM || move.move_type == OPTION) {
+        *out += ",\"source\":";
+        *out += std::to_string(move.source);
+        *out += ",\"target\":";
+        *out += std::to_string(move.target);
+    } else if (move.move_type == SPLURGE) {
+        *out += ",\"route\":[";
+        for (size_t idx = 0; idx < move.route.size(); ++idx) {
+            if (idx > 0) *out += ',';
+            *out += std::to_string(move.route[idx]);
+        }
+        *out += ']';
     }
-    v.get<json::object>()["state"] = json::value(state);
-    return v.serialize();
+    *out += '}';
+    if (state) {
+        *out += ",\"state\":\"";
+        state(out);
+        *out += '"';
+    }
+    *out += '}';
 }
 
 }
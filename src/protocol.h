@@ -1,8 +1,10 @@
 #pragma once
 
+#include <functional>
 #include <string>
 #include <vector>
 #include "picojson/picojson.h"
+#include "scanner.h"
 
 namespace proto {
 
@@ -44,15 +46,86 @@ struct Move {
     static inline Move claim(int p, int s, int t) { return Move(CLAIM, p, s, t); }
     static inline Move pass(int p) { return Move(PASS, p, 0, 0); }
     static inline Move option(int p, int s, int t) { return Move(OPTION, p, s, t); }
+    /** claim every river along route, a list of sites */
+    static inline Move splurge(int p, const std::vector<int>& route) {
+        Move m(SPLURGE, p, route.front(), route.back());
+        m.route = route;
+        return m;
+    }
 
     MoveType move_type;
     int punter;
     int source;
     int target;
+    std::vector<int> route; // SPLURGE only
 };
 
 typedef std::vector<Move> Moves;
 
+/** part of a message buffer, stands in for string_view */
+struct Slice {
+    const char* data;
+    size_t size;
+};
+
+enum MessageType {SETUP, MOVE, STOP, TIMEOUT, UNKNOWN};
+
+/** top level message type, found without parsing the whole message */
+MessageType message_type(const std::string& raw);
+
+/**
+ * Setup message read straight from the raw text, without a picojson tree
+ * or Setup vectors. Sites and rivers are scanned again on every call, so
+ * the map can be consumed in several passes. Keeps a pointer into raw.
+ */
+class SetupView {
+public:
+    explicit SetupView(const std::string& raw);
+
+    int punter;
+    int punters;
+    bool has_futures;
+    bool has_splurges;
+    bool has_options;
+    std::vector<int> mines;
+
+    template<typename F>
+    void for_each_site(F f) const {
+        JsonScanner s(sites, end);
+        s.expect('[');
+        while (s.next_item()) {
+            int id = -1;
+            s.expect('{');
+            while (s.next_key()) {
+                if (s.key_is("id")) id = s.integer();
+                else s.skip_value();
+            }
+            f(id);
+        }
+    }
+
+    template<typename F>
+    void for_each_river(F f) const {
+        JsonScanner s(rivers, end);
+        s.expect('[');
+        while (s.next_item()) {
+            int source = -1, target = -1;
+            s.expect('{');
+            while (s.next_key()) {
+                if (s.key_is("source")) source = s.integer();
+                else if (s.key_is("target")) target = s.integer();
+                else s.skip_value();
+            }
+            f(source, target);
+        }
+    }
+
+private:
+    const char* sites;
+    const char* rivers;
+    const char* end;
+};
+
 
 //**********************************************
 
@@ -64,10 +137,29 @@ std::string write_handshake(const std::string& handshake);
 
 Setup read_setup(const json::value::object& root);
 
+/**
+ * appends state string contents to a message, base64 needs no escaping;
+ * empty in online mode, where no state field is sent
+ */
+typedef std::function<void(std::string*)> AppendState;
+
 std::string write_punter_ready(int punter, const std::vector<Future>& futures, const std::string& state);
 
+/** write ready message into out, state is produced right in place */
+void write_punter_ready(int punter, const std::vector<Future>& futures, const AppendState& state,
+                        std::string* out);
+
 void read_moves(const json::value::object& root, Moves* game);
 
+/**
+ * Read moves of a move message without a picojson tree and point state at
+ * the state string inside raw. The rare escaped state is unescaped in place.
+ */
+void read_moves(std::string* raw, Moves* moves, Slice* state);
+
 std::string write_move(const proto::Move& move, const std::string& state);
 
+/** write move message into out, state is produced right in place */
+void write_move(const proto::Move& move, const AppendState& state, std::string* out);
+
 }
@@ -0,0 +1,137 @@
+#include "rollout.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include "score.h"
+#include "unionfind.h"
+
+
+Rollouts::Rollouts(State* state, ThreadPool& pool):state(state), pool(pool),
+                                                   me(state->whoami()),
+                                                   punters(state->get_header()->punters_sz),
+                                                   status(state->num_edges()),
+                                                   free_pos(state->num_edges(), UNDEFINED),
+                                                   scratch(pool.size())
+{
+    // build the table unless the caller did, playouts only read it
+    Deadline unlimited;
+    bool ok = state->build_distances(&unlimited);
+    assert(ok);
+    (void)ok;
+
+    turns = std::max(state->moves_left(), 0) * punters;
+    for (uint32_t idx = 0; idx < state->num_edges(); ++idx) {
+        if (state->owned_by(idx, me)) {
+            status[idx] = MINE;
+        } else if (state->get_edge(idx)->is_claimed()) {
+            status[idx] = OTHER;
+        } else {
+            status[idx] = FREE;
+            free_pos[idx] = free.size();
+            free.push_back(idx);
+        }
+    }
+    for (size_t idx = 0; idx < scratch.size(); ++idx) {
+        Scratch* s = &scratch[idx];
+        s->status.resize(status.size());
+        s->free.resize(free.size());
+        s->parent.resize(state->get_header()->nodes);
+    }
+}
+
+uint32_t
+Rollouts::evaluate(const std::vector<uint32_t>& candidates, uint32_t max_playouts,
+                   Deadline* deadline, std::vector<double>* mean)
+{
+    for (Scratch& s: scratch) {
+        s.sums.assign(candidates.size(), 0);
+        s.counts.assign(candidates.size(), 0);
+    }
+    uint32_t slots = scratch.size();
+    uint32_t seed = state->get_header()->move_seq * 7919;
+    pool.parallel_for(slots, [&](size_t slot) {
+        Scratch* s = &scratch[slot];
+        Deadline local = deadline->for_thread();
+        // round robin over the candidates, this slot's share of max_playouts;
+        // seeded per playout, so results do not depend on the thread count
+        for (uint32_t round = slot; round < max_playouts; round += slots) {
+            for (size_t c = 0; c < candidates.size(); ++c) {
+                if (local.expired()) return;
+                s->rng.seed(seed + round * candidates.size() + c);
+                s->sums[c] += playout(s, candidates[c]);
+                s->counts[c]++;
+            }
+        }
+    });
+
+    mean->assign(candidates.size(), 0);
+    uint32_t least = max_playouts;
+    for (size_t c = 0; c < candidates.size(); ++c) {
+        int64_t sum = 0;
+        uint32_t count = 0;
+        for (const Scratch& s: scratch) {
+            sum += s.sums[c];
+            count += s.counts[c];
+        }
+        (*mean)[c] = count > 0 ? static_cast<double>(sum) / count : 0;
+        least = std::min(least, count);
+    }
+    return least;
+}
+
+int64_t
+Rollouts::playout(Scratch* s, uint32_t candidate)
+{
+    assert(status[candidate] == FREE);
+    memcpy(s->status.data(), status.data(), status.size());
+    memcpy(s->free.data(), free.data(), free.size() * sizeof(uint32_t));
+    uint32_t left = free.size();
+
+    s->status[candidate] = MINE;
+    s->free[free_pos[candidate]] = s->free[--left];
+
+    uint32_t claims = std::min(left, turns > 0 ? turns - 1 : 0);
+    uint32_t punter = (me + 1) % punters;
+    for (uint32_t i = 0; i < claims; ++i) {
+        uint32_t pick = s->rng() % left;
+        uint32_t e = s->free[pick];
+        s->free[pick] = s->free[--left];
+        s->status[e] = punter == me ? MINE : OTHER;
+        punter = punter + 1 == punters ? 0 : punter + 1;
+    }
+    return final_score(s);
+}
+
+int64_t
+Rollouts::final_score(Scratch* s)
+{
+    // components of our rivers, flattened so that a row of the distance
+    // table can be scanned against them linearly
+    uint32_t nodes = state->get_header()->nodes;
+    for (uint32_t node = 0; node < nodes; ++node) s->parent[node] = node;
+    for (uint32_t idx = 0; idx < status.size(); ++idx) {
+        if (s->status[idx] != MINE) continue;
+        Edge* e = state->get_edge(idx);
+        unionfind::join(s->parent.data(), e->source, e->target);
+    }
+    for (uint32_t node = 0; node < nodes; ++node) s->parent[node] = unionfind::find(s->parent.data(), node);
+
+    int64_t result = 0;
+    for (uint32_t m = 0; m < state->num_mines(); ++m) {
+        const uint16_t* dist = state->mine_distances(m);
+        uint32_t root = s->parent[state->get_mine(m)->site_id];
+        uint64_t sum = 0;
+        for (uint32_t node = 0; node < nodes; ++node) {
+            uint64_t d = dist[node];
+            sum += s->parent[node] == root ? d * d : 0;
+        }
+        result += sum;
+    }
+    for (uint32_t idx = 0; idx < state->num_bets(); ++idx) {
+        const Bet* bet = state->get_bet(idx);
+        bool won = s->parent[state->get_mine(bet->mine_id)->site_id] == s->parent[bet->site_id];
+        result += bet_value(state->mine_distance(bet->mine_id, bet->site_id), won);
+    }
+    return result;
+}
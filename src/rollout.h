@@ -0,0 +1,58 @@
+#pragma once
+
+#include <random>
+#include <vector>
+#include <stdint.h>
+#include "deadline.h"
+#include "pool.h"
+#include "state.h"
+
+/**
+ * Monte Carlo playouts from the current position: we claim a candidate
+ * river, then every punter in turn claims a random free river until the
+ * game ends, and our final score is measured.
+ *
+ * A playout works on a copy of the per-river status only, a byte per river,
+ * and never allocates. Playouts run on every thread of the pool, each with
+ * its own RNG and scratch; every playout is seeded on its own, so results
+ * do not depend on the number of threads. Options and splurges are not simulated.
+ */
+class Rollouts {
+public:
+    /** needs a map with a distance table, builds it if not done yet */
+    explicit Rollouts(State* state, ThreadPool& pool = thread_pool());
+
+    /**
+     * Mean final score for us of claiming each of the candidate rivers now,
+     * max_playouts per candidate or as many as fit before the deadline.
+     * Return the smallest number of playouts any candidate got.
+     */
+    uint32_t evaluate(const std::vector<uint32_t>& candidates, uint32_t max_playouts,
+                      Deadline* deadline, std::vector<double>* mean);
+
+private:
+    enum : uint8_t { FREE, MINE, OTHER };
+
+    struct Scratch {
+        std::vector<uint8_t> status;   // per edge
+        std::vector<uint32_t> free;    // free edge ids, unordered
+        std::vector<uint32_t> parent;  // union-find over our rivers, per node
+        std::mt19937 rng;
+        std::vector<int64_t> sums;     // per candidate
+        std::vector<uint32_t> counts;  // per candidate
+    };
+
+    State* state;
+    ThreadPool& pool;
+    uint32_t me;
+    uint32_t punters;
+    uint32_t turns;                 // claims left in the game, ours included
+    std::vector<uint8_t> status;    // position to start every playout from
+    std::vector<uint32_t> free;
+    std::vector<uint32_t> free_pos; // index into free, per free edge
+    std::vector<Scratch> scratch;   // per pool slot
+
+    /** our final score after claiming candidate and playing at random */
+    int64_t playout(Scratch* s, uint32_t candidate);
+    int64_t final_score(Scratch* s);
+};
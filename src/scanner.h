@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+namespace proto {
+
+/**
+ * Pull-style JSON scanner over a raw message, no tree is built.
+ * Objects and arrays are walked with next_key()/next_item(), anything
+ * not needed is skipped with skip_value(). Malformed input asserts.
+ */
+class JsonScanner {
+public:
+    JsonScanner(const char* begin, const char* end): pos(begin), end(end) {}
+
+    const char* position() const { return pos; }
+    void seek(const char* p) { pos = p; }
+
+    void ws() {
+        while (pos < end && (*pos == ' ' || *pos == '\n' || *pos == '\r' || *pos == '\t')) ++pos;
+    }
+
+    char peek() {
+        ws();
+        assert(pos < end);
+        return *pos;
+    }
+
+    void expect(char c) {
+        ws();
+        assert(pos < end && *pos == c);
+        (void)c;
+        ++pos;
+    }
+
+    /** move to the next member of the object whose '{' was consumed; false at '}' */
+    bool next_key() {
+        if (!next_element('}')) return false;
+        string(&key_begin, &key_len);
+        expect(':');
+        return true;
+    }
+
+    /** key of the member found by next_key() */
+    bool key_is(const char* k) const {
+        return strlen(k) == key_len && memcmp(k, key_begin, key_len) == 0;
+    }
+
+    /** move to the next item of the array whose '[' was consumed; false at ']' */
+    bool next_item() { return next_element(']'); }
+
+    /** string contents without unescaping */
+    void string(const char** s, size_t* len) {
+        expect('"');
+        const char* q = pos;
+        while (true) {
+            q = static_cast<const char*>(memchr(q, '"', end - q));
+            assert(q != nullptr);
+            size_t slashes = 0;
+            while (q - slashes - 1 >= pos && q[-static_cast<long>(slashes) - 1] == '\\') ++slashes;
+            if (slashes % 2 == 0) break;
+            ++q;
+        }
+        *s = pos;
+        *len = q - pos;
+        pos = q + 1;
+    }
+
+    int integer() {
+        ws();
+        bool neg = pos < end && *pos == '-';
+        if (neg) ++pos;
+        int v = 0;
+        const char* start = pos;
+        while (pos < end && *pos >= '0' && *pos <= '9') v = v * 10 + (*pos++ - '0');
+        if (pos < end && (*pos == '.' || *pos == 'e' || *pos == 'E')) {
+            // not an integer literal, fall back to the full parser
+            pos = start;
+            return static_cast<int>((neg ? -1 : 1) * number());
+        }
+        return neg ? -v : v;
+    }
+
+    double number() {
+        ws();
+        char* num_end;
+        double v = strtod(pos, &num_end);
+        assert(num_end != pos && num_end <= end);
+        pos = num_end;
+        return v;
+    }
+
+    bool boolean() {
+        ws();
+        if (end - pos >= 4 && memcmp(pos, "true", 4) == 0) {
+            pos += 4;
+            return true;
+        }
+        assert(end - pos >= 5 && memcmp(pos, "false", 5) == 0);
+        pos += 5;
+        return false;
+    }
+
+    void skip_value() {
+        char c = peek();
+        if (c == '"') {
+            const char* s;
+            size_t len;
+            string(&s, &len);
+        } else if (c == '{' || c == '[') {
+            // skip nested containers, strings may contain brackets
+            int depth = 0;
+            do {
+                c = peek();
+                if (c == '"') {
+                    const char* s;
+                    size_t len;
+                    string(&s, &len);
+                    continue;
+                }
+                if (c == '{' || c == '[') ++depth;
+                if (c == '}' || c == ']') --depth;
+                ++pos;
+            } while (depth > 0);
+        } else {
+            // number or literal
+            while (pos < end && *pos != ',' && *pos != '}' && *pos != ']'
+                   && *pos != ' ' && *pos != '\n' && *pos != '\r' && *pos != '\t') ++pos;
+        }
+    }
+
+private:
+    const char* pos;
+    const char* end;
+    const char* key_begin = nullptr;
+    size_t key_len = 0;
+
+    bool next_element(char close) {
+        char c = peek();
+        if (c == close) {
+            ++pos;
+            return false;
+        }
+        if (c == ',') ++pos;
+        return true;
+    }
+};
+
+}
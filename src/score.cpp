@@ -0,0 +1,193 @@
+#include "score.h"
+
+#include <cassert>
+#include <numeric>
+#include "unionfind.h"
+
+
+namespace {
+
+const uint32_t NO_ROW = UNDEFINED;
+
+uint64_t
+dist_sq(uint16_t d)
+{
+    return d == DIST_UNREACHABLE ? 0 : static_cast<uint64_t>(d) * d;
+}
+
+/**
+ * Distances from mine #m over all rivers: the table when the map has one,
+ * else a BFS into row.
+ */
+const uint16_t*
+mine_row(State* state, uint32_t m, std::vector<uint16_t>* row)
+{
+    Deadline unlimited;
+    if (state->build_distances(&unlimited)) return state->mine_distances(m);
+    row->assign(state->get_header()->nodes, DIST_UNREACHABLE);
+    std::vector<uint32_t> queue = {state->get_mine(m)->site_id};
+    (*row)[queue[0]] = 0;
+    for (size_t head = 0; head < queue.size(); ++head) {
+        uint32_t node = queue[head];
+        uint16_t d = (*row)[node] >= DIST_MAX ? DIST_MAX : (*row)[node] + 1;
+        auto iter = state->get_edges_iter(node);
+        for (auto i = iter.first; i < iter.second; ++i) {
+            uint32_t t = state->neighbor_by_ref(i);
+            if ((*row)[t] != DIST_UNREACHABLE) continue;
+            (*row)[t] = d;
+            queue.push_back(t);
+        }
+    }
+    return row->data();
+}
+
+}
+
+Scores::Scores(State* state):state(state),
+                             num_mines(state->num_mines()),
+                             num_nodes(state->get_header()->nodes),
+                             punters(state->get_header()->punters_sz)
+{
+    // State::scores() does not make one for maps without a table
+    Deadline unlimited;
+    bool ok = state->build_distances(&unlimited);
+    assert(ok);
+    (void)ok;
+    state->for_each_owned_river([&](uint32_t idx, uint32_t punter) {
+        Edge* e = state->get_edge(idx);
+        add_river(punter, e->source, e->target);
+    });
+}
+
+void
+Scores::add_river(uint32_t punter, uint32_t source, uint32_t target)
+{
+    assert(punter < punters.size());
+    // nothing to score without mines, and no futures either
+    if (num_mines == 0) return;
+    Punter* p = &punters[punter];
+    if (p->parent.empty()) {
+        p->parent.resize(num_nodes);
+        std::iota(p->parent.begin(), p->parent.end(), 0);
+        p->row.assign(num_nodes, NO_ROW);
+    }
+    uint32_t a = find(p, source);
+    uint32_t b = find(p, target);
+    if (a == b) return;
+    // keep the root that already has a row
+    if (p->row[a] == NO_ROW) std::swap(a, b);
+    p->reach -= component_score(p, a) + component_score(p, b);
+
+    if (p->row[a] == NO_ROW) p->row[a] = take_row(a);
+    uint64_t* sums = &rows[static_cast<size_t>(p->row[a]) * num_mines];
+    if (p->row[b] == NO_ROW) {
+        for (uint32_t m = 0; m < num_mines; ++m) sums[m] += dist_sq(state->mine_distance(m, b));
+    } else {
+        const uint64_t* other = &rows[static_cast<size_t>(p->row[b]) * num_mines];
+        for (uint32_t m = 0; m < num_mines; ++m) sums[m] += other[m];
+        free_rows.push_back(p->row[b]);
+        p->row[b] = NO_ROW;
+    }
+    p->parent[b] = a;
+
+    p->reach += component_score(p, a);
+}
+
+int64_t
+Scores::score(uint32_t punter)
+{
+    assert(punter < punters.size());
+    int64_t result = punters[punter].reach;
+    if (punter == static_cast<uint32_t>(state->whoami())) result += futures_score();
+    return result;
+}
+
+int64_t
+Scores::futures_score()
+{
+    Punter* p = &punters[state->whoami()];
+    int64_t result = 0;
+    for (uint32_t idx = 0; idx < state->num_bets(); ++idx) {
+        const Bet* bet = state->get_bet(idx);
+        uint32_t mine = state->get_mine(bet->mine_id)->site_id;
+        bool won = !p->parent.empty() && find(p, mine) == find(p, bet->site_id);
+        result += bet_value(state->mine_distance(bet->mine_id, bet->site_id), won);
+    }
+    return result;
+}
+
+uint32_t
+Scores::find(Punter* p, uint32_t node)
+{
+    return unionfind::find(p->parent.data(), node);
+}
+
+uint64_t
+Scores::component_score(Punter* p, uint32_t root)
+{
+    // a lone node scores nothing, not even a mine
+    if (p->row[root] == NO_ROW) return 0;
+    const uint64_t* sums = &rows[static_cast<size_t>(p->row[root]) * num_mines];
+    uint64_t result = 0;
+    for (uint32_t m = 0; m < num_mines; ++m) {
+        if (find(p, state->get_mine(m)->site_id) == root) result += sums[m];
+    }
+    return result;
+}
+
+uint32_t
+Scores::take_row(uint32_t node)
+{
+    uint32_t row;
+    if (!free_rows.empty()) {
+        row = free_rows.back();
+        free_rows.pop_back();
+    } else {
+        row = rows.size() / num_mines;
+        rows.resize(rows.size() + num_mines);
+    }
+    uint64_t* sums = &rows[static_cast<size_t>(row) * num_mines];
+    for (uint32_t m = 0; m < num_mines; ++m) sums[m] = dist_sq(state->mine_distance(m, node));
+    return row;
+}
+
+int64_t
+bet_value(uint16_t d, bool won)
+{
+    int64_t cube = d == DIST_UNREACHABLE ? 0 : static_cast<int64_t>(d) * d * d;
+    return won ? cube : -cube;
+}
+
+int64_t
+naive_score(State* state, uint32_t punter)
+{
+    bool me = punter == static_cast<uint32_t>(state->whoami());
+    int64_t result = 0;
+    std::vector<uint16_t> row;
+    for (uint32_t m = 0; m < state->num_mines(); ++m) {
+        const uint16_t* dist = mine_row(state, m, &row);
+        uint32_t root = state->get_mine(m)->site_id;
+        SearchSpace* search = state->new_search();
+        search->push(root);
+        search->visit(root, UNDEFINED);
+        while (!search->empty()) {
+            uint32_t node = search->pop_front();
+            result += dist_sq(dist[node]);
+            auto iter = state->get_edges_iter(node);
+            for (auto i = iter.first; i < iter.second; ++i) {
+                if (!state->owned_by(state->edge_id_by_ref(i), punter)) continue;
+                uint32_t t = state->neighbor_by_ref(i);
+                if (search->visited(t)) continue;
+                search->push(t);
+                search->visit(t, i);
+            }
+        }
+        if (!me) continue;
+        for (uint32_t idx = 0; idx < state->num_bets(); ++idx) {
+            const Bet* bet = state->get_bet(idx);
+            if (bet->mine_id != m) continue;
+            result += bet_value(dist[bet->site_id], search->visited(bet->site_id));
+        }
+    }
+    return result;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include "state.h"
+
+/**
+ * Game score of every punter as if the game ended now.
+ *
+ * Per punter: union-find over the rivers it claimed or optioned. Each
+ * component with more than one node owns a row of per-mine sums of
+ * dist(mine, node)^2 over its nodes, so joining two components costs
+ * O(mines) regardless of their size. Score of a component is the sum of the
+ * row entries of the mines inside it.
+ */
+class Scores {
+public:
+    /** built from the river owners recorded in state, needs a distance table */
+    explicit Scores(State* state);
+
+    /** punter claimed or optioned the river source-target */
+    void add_river(uint32_t punter, uint32_t source, uint32_t target);
+
+    /** our futures are counted, bets of the others are unknown */
+    int64_t score(uint32_t punter);
+
+    /** +d^3 for every bet connected so far, -d^3 for the rest */
+    int64_t futures_score();
+
+private:
+    struct Punter {
+        std::vector<uint32_t> parent; // empty until the first river
+        std::vector<uint32_t> row;    // per root, NO_ROW for a single node
+        int64_t reach = 0;            // sum of dist^2 over all components
+    };
+
+    State* state;
+    uint32_t num_mines;
+    uint32_t num_nodes;
+    std::vector<Punter> punters;
+    std::vector<uint64_t> rows;        // num_mines sums per row
+    std::vector<uint32_t> free_rows;
+
+    uint32_t find(Punter* p, uint32_t node);
+    uint64_t component_score(Punter* p, uint32_t root);
+    /** new row holding dist^2 from node to every mine */
+    uint32_t take_row(uint32_t node);
+};
+
+/** +d^3 for a bet won, -d^3 for one lost, nothing for an unreachable site */
+int64_t bet_value(uint16_t d, bool won);
+
+/**
+ * Score by a search from every mine, to check Scores against. Works on
+ * maps without a distance table too, with a BFS per mine.
+ */
+int64_t naive_score(State* state, uint32_t punter);
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+
+/**
+ * Scratch space for graph searches over dense node ids.
+ * Visited marks are stamped with an epoch, so reset() is O(1) instead of
+ * clearing a table; parent holds the edge ref the node was reached by.
+ */
+class SearchSpace {
+public:
+    /** start a new search over `nodes` nodes */
+    void reset(uint32_t nodes) {
+        if (stamp.size() < nodes) {
+            stamp.resize(nodes, 0);
+            parent.resize(nodes);
+            // every node is queued at most once, so searches never allocate
+            queue.reserve(nodes);
+        }
+        if (++epoch == 0) {
+            // wrapped around, old stamps could look current
+            std::fill(stamp.begin(), stamp.end(), 0);
+            epoch = 1;
+        }
+        queue.clear();
+        head = 0;
+    }
+
+    bool visited(uint32_t node) const { return stamp[node] == epoch; }
+
+    void visit(uint32_t node, uint32_t parent_ref) {
+        stamp[node] = epoch;
+        parent[node] = parent_ref;
+    }
+
+    uint32_t parent_ref(uint32_t node) const { return parent[node]; }
+
+    // FIFO on top of a reused vector, also usable as a stack via pop_back
+    void push(uint32_t node) { queue.push_back(node); }
+    bool empty() const { return head == queue.size(); }
+    /** nodes queued and not popped yet */
+    size_t size() const { return queue.size() - head; }
+    /** nodes queued since reset, when used as a FIFO */
+    size_t pushed() const { return queue.size(); }
+    uint32_t pop_front() { return queue[head++]; }
+    uint32_t pop_back() { uint32_t n = queue.back(); queue.pop_back(); return n; }
+
+private:
+    std::vector<uint32_t> stamp;
+    std::vector<uint32_t> parent;
+    std::vector<uint32_t> queue;
+    size_t head = 0;
+    uint32_t epoch = 0;
+};
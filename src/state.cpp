@@ -2,27 +2,99 @@
 
 #include <cassert>
 #include <cmath>
+#include <cstring>
 #include <algorithm>
+#include <atomic>
 #include <random>
-#include <queue>
-#include <unordered_map>
-#include "base64/base64.h"
+#include "arena.h"
+#include "base64/base64_simd.h"
+#include "compress.h"
+#include "pool.h"
+#include "score.h"
+#include "unionfind.h"
 
 
 namespace {
 
+const int kEdgeFlags = 4;
+
+// bodies shorter than this are not worth compressing
+const size_t kCompressMin = 256;
+
+// largest mines x nodes distance table, 32 MB
+const size_t kMaxDistEntries = 16 << 20;
+
+/** number of distance table entries, 0 if over budget */
+size_t
+dist_entries_of(const Header& h)
+{
+    size_t entries = static_cast<size_t>(h.mines) * h.nodes;
+    return entries <= kMaxDistEntries ? entries : 0;
+}
+
+/** byte offsets of the sections of the state buffer, size is its end */
+struct Layout {
+    size_t nodes, edge_refs, edges, site_ids, mines, distances, components, frontier;
+    size_t bits, owners, option_owners, bets, targets, size;
+    size_t owner_bytes;
+};
+
+Layout
+layout_of(const Header& h)
+{
+    Layout l;
+    l.nodes = sizeof(Header);
+    l.edge_refs = l.nodes + sizeof(Node) * h.nodes;
+    l.edges = l.edge_refs + sizeof(EdgeRef) * h.edges * 2;
+    l.site_ids = l.edges + sizeof(Edge) * h.edges;
+    l.mines = l.site_ids + sizeof(uint32_t) * h.nodes;
+    l.distances = l.mines + sizeof(Mine) * h.mines;
+    // keep what follows 8-byte aligned
+    l.components = l.distances + (sizeof(uint16_t) * dist_entries_of(h) + 7) / 8 * 8;
+    l.frontier = l.components + sizeof(uint32_t) * h.nodes;
+    l.bits = l.frontier + (sizeof(uint32_t) * h.nodes + 7) / 8 * 8;
+    l.owner_bytes = h.punters_sz < 0xff ? 1 : 2;
+    l.owners = l.bits + 2 * sizeof(uint64_t) * ((h.edges + 63) / 64);
+    l.option_owners = l.owners + l.owner_bytes * h.edges;
+    l.bets = l.owners + (2 * l.owner_bytes * h.edges + 7) / 8 * 8;
+    l.targets = l.bets + sizeof(Bet) * h.futures;
+    l.size = l.targets + sizeof(Target) * h.targets;
+    return l;
+}
+
+uint32_t
+edge_flag(const Edge& e, int flag)
+{
+    switch (flag) {
+    case 0: return e.claimed;
+    case 1: return e.option;
+    case 2: return e.me;
+    default: return e.breadcrumb;
+    }
+}
+
+void
+set_edge_flag(Edge* e, int flag, uint32_t v)
+{
+    switch (flag) {
+    case 0: e->claimed = v; break;
+    case 1: e->option = v; break;
+    case 2: e->me = v; break;
+    default: e->breadcrumb = v; break;
+    }
+}
+
 
 // return path
 void
 unpack_path(State* state, uint32_t from, uint32_t to,
-            const std::unordered_map<uint32_t, uint32_t>& visited,
+            const SearchSpace& search,
             std::vector<Edge*>* result)
 {
     if (from == to) return;
     uint32_t cur = to;
     do {
-        const auto it = visited.at(cur);
-        Edge* e = state->get_edge_by_ref(it);
+        Edge* e = state->get_edge_by_ref(search.parent_ref(cur));
         result->push_back(e);
         uint32_t prev = e->target != cur ? e->target: e->source;
         cur = prev;
@@ -31,29 +103,28 @@ unpack_path(State* state, uint32_t from, uint32_t to,
 }
 
 bool
-nearest_mine_path(State* state, uint32_t root, std::vector<Edge*>* path)
+nearest_mine_path(State* state, uint32_t root, std::vector<Edge*>* path, Deadline* deadline,
+                  unsigned slot = 0)
 {
-    std::queue<uint32_t> queue;
-    std::unordered_map<uint32_t, uint32_t> visited;
+    SearchSpace* search = state->new_search(slot);
 
-    queue.push(root);
-    visited.emplace(root, UNDEFINED);
+    search->push(root);
+    search->visit(root, UNDEFINED);
 
-    while(!queue.empty()) {
-        uint32_t node = queue.front();
-        queue.pop();
+    while(!search->empty()) {
+        if (deadline->poll()) return false;
+        uint32_t node = search->pop_front();
         auto iter = state->get_edges_iter(node);
         for (auto i = iter.first; i < iter.second; ++i) {
-            Edge* e = state->get_edge_by_ref(i);
             // can travel
-            uint32_t t = e->source == node ? e->target: e->source;
-            if (visited.find(t) != visited.end()) continue; // already visited
-            queue.push(t);
-            visited.emplace(t, i);
+            uint32_t t = state->neighbor_by_ref(i);
+            if (search->visited(t)) continue; // already visited
+            search->push(t);
+            search->visit(t, i);
             if (state->is_mine(t)) {
                 // unpack path
                 path->clear();
-                unpack_path(state, root, t, visited, path);
+                unpack_path(state, root, t, *search, path);
                 return true;
             }
         }
@@ -61,30 +132,65 @@ nearest_mine_path(State* state, uint32_t root, std::vector<Edge*>* path)
     return false;
 }
 
+/** nearest_mine_path by walking down the distance table */
 bool
-longest_breadcrumb_path(State* state, uint32_t root, std::vector<Edge*>* path)
+nearest_mine_path_by_table(State* state, uint32_t mine_idx, std::vector<Edge*>* path, Deadline* deadline,
+                           unsigned slot)
 {
-    std::queue<uint32_t> queue;
-    std::unordered_map<uint32_t, uint32_t> visited;
+    uint32_t root = state->get_mine(mine_idx)->site_id;
+    uint32_t best = UNDEFINED;
+    uint16_t best_dist = DIST_MAX;
+    for (uint32_t m = 0; m < state->num_mines(); ++m) {
+        uint16_t d = state->mine_distance(m, root);
+        if (m != mine_idx && d < best_dist) {
+            best = m;
+            best_dist = d;
+        }
+    }
+    if (best == UNDEFINED) {
+        // no other mine in reach, or too far for the table to tell
+        return nearest_mine_path(state, root, path, deadline, slot);
+    }
 
-    queue.push(root);
-    visited.emplace(root, UNDEFINED);
+    const uint16_t* dist = state->mine_distances(best);
+    path->clear();
+    for (uint32_t node = root; dist[node] != 0; ) {
+        auto iter = state->get_edges_iter(node);
+        for (auto i = iter.first; i < iter.second; ++i) {
+            uint32_t t = state->neighbor_by_ref(i);
+            if (dist[t] + 1 == dist[node]) {
+                path->push_back(state->get_edge_by_ref(i));
+                node = t;
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+bool
+longest_breadcrumb_path(State* state, uint32_t root, std::vector<Edge*>* path, Deadline* deadline)
+{
+    SearchSpace* search = state->new_search();
+
+    search->push(root);
+    search->visit(root, UNDEFINED);
 
-    while(!queue.empty()) {
-        uint32_t node = queue.front();
-        queue.pop();
+    while(!search->empty()) {
+        if (deadline->poll()) return false;
+        uint32_t node = search->pop_front();
         auto iter = state->get_edges_iter(node);
         for (auto i = iter.first; i < iter.second; ++i) {
             Edge* e = state->get_edge_by_ref(i);
             if (!e->is_breadcrumb()) continue;
             // can travel
             uint32_t t = e->source == node ? e->target: e->source;
-            if (visited.find(t) != visited.end()) continue; // already visited
-            queue.push(t);
-            visited.emplace(t, i);
+            if (search->visited(t)) continue; // already visited
+            search->push(t);
+            search->visit(t, i);
         }
-        if (queue.empty() && root != node) {
-            unpack_path(state, root, node, visited, path);
+        if (search->empty() && root != node) {
+            unpack_path(state, root, node, *search, path);
             return true;
         }
     }
@@ -93,15 +199,25 @@ longest_breadcrumb_path(State* state, uint32_t root, std::vector<Edge*>* path)
 }
 
 void
-setup_execution_plan(State* state, std::vector<proto::Future>* futures,  std::vector<Target>* targets)
+setup_execution_plan(State* state, std::vector<proto::Future>* futures,  std::vector<Target>* targets,
+                     Deadline* deadline)
 {
     std::vector<std::vector<Edge*>> mine_paths(state->num_mines());
-    // for each mine find shorest path to another main
+    std::vector<char> found(state->num_mines(), 0);
+    // the searches share the table, build it before they start
+    bool by_table = state->build_distances(deadline);
+    // for each mine find shorest path to another main, as many as time allows
+    thread_pool().parallel_tasks(state->num_mines(), [&](size_t i, unsigned slot) {
+        Deadline local = deadline->for_thread();
+        if (local.expired()) return;
+        found[i] = by_table
+            ? nearest_mine_path_by_table(state, i, &mine_paths[i], &local, slot)
+            : nearest_mine_path(state, state->get_mine(i)->site_id, &mine_paths[i], &local, slot);
+    });
     std::vector<std::pair<int, int>> ordered_by_shortest;
     for (uint32_t i = 0; i < state->num_mines(); ++i) {
-        bool res = nearest_mine_path(state, state->get_mine(i)->site_id, &mine_paths[i]);
-        assert(res);
-        if (res) {
+        assert(found[i] || deadline->expired());
+        if (found[i]) {
             ordered_by_shortest.emplace_back(mine_paths[i].size(), i);
         }
     }
@@ -138,11 +254,11 @@ setup_execution_plan(State* state, std::vector<proto::Future>* futures,  std::ve
         // find longest breadcrumb path
         size_t NFUT = (size_t)ceil( (state->get_header()->options_avail > 0 ? 0.3: 0.1) * state->num_mines());
         std::vector<Edge*> longest, work;
-        for (uint32_t i = 0; i < NFUT ; ++i) {
+        for (uint32_t i = 0; i < NFUT && !deadline->expired(); ++i) {
             //
             work.resize(0);
             uint32_t mine_id = state->get_mine(i)->site_id;
-            longest_breadcrumb_path(state, mine_id, &work);
+            longest_breadcrumb_path(state, mine_id, &work, deadline);
 #ifdef DEBUG
             std::cerr << "Longest for " << mine_id << ": " << work.size() << std::endl;
 #endif
@@ -186,93 +302,222 @@ setup_execution_plan(State* state, std::vector<proto::Future>* futures,  std::ve
 
 }
 
-State::State(proto::Setup& setup):data(0)
+namespace {
+
+/** proto::Setup with the map interface of proto::SetupView */
+struct SetupMap {
+    const proto::Setup& setup;
+
+    template<typename F>
+    void for_each_site(F f) const { for (const auto& site: setup.map.sites) f(site.id); }
+
+    template<typename F>
+    void for_each_river(F f) const { for (const auto& r: setup.map.rivers) f(r.source, r.target); }
+};
+
+}
+
+State::State(proto::Setup& setup):data(0), searches(2 * thread_pool().size())
+{
+    init(setup, setup.map.mines, SetupMap{setup});
+}
+
+State::State(const proto::SetupView& setup):data(0), searches(2 * thread_pool().size())
 {
-    data.resize(sizeof(Header));
-    header = reinterpret_cast<Header*>(data.data());
-    header->punters_sz = setup.punters;
-    header->punter_id = setup.punter;
-    header->move_seq = 0;
+    init(setup, setup.mines, setup);
+}
+
+template<typename Settings, typename Map>
+void
+State::init(const Settings& setup, std::vector<int> mine_sites, const Map& map)
+{
+    Header h = Header();
+    h.punters_sz = setup.punters;
+    assert(setup.punters < 0xffff);
+    h.punter_id = setup.punter;
+    h.move_seq = 0;
     std::cerr << "I AM A PUNTER #" << setup.punter << std::endl;
 
     std::random_device rd;
     std::mt19937 g(rd());
 
-    std::shuffle(setup.map.mines.begin(), setup.map.mines.end(), g);
+    std::shuffle(mine_sites.begin(), mine_sites.end(), g);
+
+    // scratch lives in the arena, the state buffer is allocated once its
+    // sections are known
+    Arena arena;
 
-    // find maximum node_id (assume that id's are contiguous and not random)
-    int max_node_id = 0;
-    for (const auto& a: setup.map.sites) {
-        max_node_id = std::max(a.id, max_node_id);
+    // sites get node ids of our own, in BFS order from the mines, so that
+    // neighbors sit close together whatever ids the server uses
+    uint32_t num_sites = 0;
+    map.for_each_site([&](int) { ++num_sites; });
+    uint32_t* sites = arena.alloc<uint32_t>(num_sites);
+    {
+        uint32_t idx = 0;
+        map.for_each_site([&](int id) { sites[idx++] = id; });
+    }
+    uint32_t* rank = arena.alloc<uint32_t>(num_sites, UNDEFINED);
+    uint32_t* first = arena.alloc<uint32_t>(num_sites + 2, 0);
+    IdMap by_site;
+    by_site.build(sites, num_sites);
+    auto index = [&](int id) {
+        uint32_t idx = UNDEFINED;
+        bool ok = by_site.find(id, &idx);
+        assert(ok);
+        (void)ok;
+        return idx;
+    };
+    // adjacency of the sites in the order they came in
+    uint32_t* begin = arena.alloc<uint32_t>(num_sites + 1, 0);
+    map.for_each_river([&](int s, int t) {
+        begin[index(s) + 1]++;
+        begin[index(t) + 1]++;
+    });
+    for (uint32_t idx = 1; idx <= num_sites; ++idx) begin[idx] += begin[idx - 1];
+    uint32_t* ends = arena.alloc<uint32_t>(begin[num_sites]);
+    uint32_t* fill = arena.alloc<uint32_t>(num_sites);
+    std::copy(begin, begin + num_sites, fill);
+    map.for_each_river([&](int s, int t) {
+        uint32_t a = index(s), b = index(t);
+        ends[fill[a]++] = b;
+        ends[fill[b]++] = a;
+    });
+
+    uint32_t* order = arena.alloc<uint32_t>(num_sites);
+    uint32_t ordered = 0;
+    auto bfs = [&](uint32_t root) {
+        if (rank[root] != UNDEFINED) return;
+        rank[root] = ordered;
+        order[ordered++] = root;
+        for (uint32_t head = ordered - 1; head < ordered; ++head) {
+            uint32_t idx = order[head];
+            for (uint32_t k = begin[idx]; k < begin[idx + 1]; ++k) {
+                if (rank[ends[k]] != UNDEFINED) continue;
+                rank[ends[k]] = ordered;
+                order[ordered++] = ends[k];
+            }
+        }
+    };
+    for (int& m: mine_sites) {
+        m = index(m);
+        bfs(m);
     }
+    for (uint32_t idx = 0; idx < num_sites; ++idx) bfs(idx);
 
-    header->nodes = max_node_id + 2; // + sentinel
-    header->edges = setup.map.rivers.size();
-    header->mines = setup.map.mines.size();
-    header->targets = 0;
+    // rivers go in canonical order (source < target, sorted), so that
+    // topology can be packed and rebuilt: count rivers per source first...
+    for (uint32_t idx = 0; idx < num_sites; ++idx) {
+        for (uint32_t k = begin[idx]; k < begin[idx + 1]; ++k) {
+            if (rank[idx] < rank[ends[k]]) first[rank[idx] + 1]++;
+        }
+    }
+    for (uint32_t idx = 1; idx <= num_sites + 1; ++idx) {
+        first[idx] += first[idx - 1];
+    }
+    uint32_t num_nodes = num_sites + 1; // + sentinel
+    assert(num_nodes - 1 < (1u << 30));
+    h.nodes = num_nodes;
+    h.edges = first[num_nodes];
+    h.mines = mine_sites.size();
+    h.targets = 0;
+    h.futures = 0;
+    h.has_futures = setup.has_futures;
+    h.options_avail = setup.has_options ? h.mines : 0;
+    h.credit = 0;
+    h.has_splurges = setup.has_splurges;
 
-    header->has_futures = setup.has_futures;
-    header->options_avail = setup.has_options ? header->mines : 0;
-    header->has_splurges = setup.has_splurges;
+    // the plan adds at most a target per mine and a bet and a target per
+    // future, one per mine at most: leave room so that it does not move
+    // the buffer. Owners are zero from resize: nobody
+    Header planned = h;
+    planned.targets = 2 * h.mines;
+    planned.futures = h.mines;
+    data.reserve(layout_of(planned).size);
+    data.resize(layout_of(h).size);
+    memcpy(data.data(), &h, sizeof(Header));
+    update_pointers();
 #ifdef DEBUG
     std::cerr << "Settings: futures: " <<  (header->has_futures != 0)
               << ", splurges: " << (header->has_splurges != 0)
               << ", options: " << header->options_avail
               << std::endl;
 #endif
-    update_pointers();
-    data.resize(sentinel - data.data());
-    update_pointers();
 
-    std::vector<std::vector<uint32_t>> edges_of_nodes(header->nodes);
-    for (size_t idx = 0; idx < setup.map.rivers.size(); ++idx) {
-        edges[idx] = Edge(setup.map.rivers[idx]);
-        assert(edges[idx].source < header->nodes);
-        assert(edges[idx].target < header->nodes);
-        edges_of_nodes[edges[idx].source].push_back(idx);
-        edges_of_nodes[edges[idx].target].push_back(idx);
+    // ...then drop them into their buckets
+    for (uint32_t idx = 0; idx < num_sites; ++idx) {
+        for (uint32_t k = begin[idx]; k < begin[idx + 1]; ++k) {
+            uint32_t a = rank[idx], b = rank[ends[k]];
+            if (a < b) edges[first[a]++] = Edge(proto::River{static_cast<int>(a), static_cast<int>(b)});
+        }
     }
-    assert(edges_of_nodes.back().empty());
-
+    for (uint32_t idx = 0; idx < num_sites; ++idx) site_ids[rank[idx]] = sites[idx];
+    site_ids[num_nodes - 1] = UNDEFINED;
+    on_path.assign((header->edges + 63) / 64, 0);
 
-    for (uint32_t idx = 0, edge_iref = 0; idx < edges_of_nodes.size(); ++idx) {
-        nodes[idx].first_edge_ref = edge_iref;
-        nodes[idx].is_mine = 0;
-        for (uint32_t e_id: edges_of_nodes[idx]) {
-            assert(edge_iref < header->edges * 2);
-            edge_refs[edge_iref++].edge_id = e_id;
-        }
+    // and sort each bucket by target
+    for (uint32_t node = 0, bucket = 0; node < num_nodes; bucket = first[node++]) {
+        std::sort(edges + bucket, edges + first[node],
+                  [](const Edge& a, const Edge& b) { return a.target < b.target; });
     }
+    build_adjacency();
+    build_components();
 
-    for (size_t idx = 0; idx < setup.map.mines.size(); ++idx) {
-        uint32_t site_id = setup.map.mines[idx];
+    for (size_t idx = 0; idx < mine_sites.size(); ++idx) {
+        uint32_t site_id = rank[mine_sites[idx]];
         mines[idx].site_id = site_id;
         nodes[site_id].is_mine = 1;
     }
 
 }
 
-State::State(const std::string& base64):data(0)
+State::~State()
 {
-    Base64::Decode(base64, &data);
-    update_pointers();
+}
+
+State::State(const std::string& base64):State(base64.data(), base64.size())
+{
+}
+
+State::State(const char* base64, size_t len):data(0), searches(2 * thread_pool().size())
+{
+    std::vector<char> packed;
+    bool ok = base64::decode(base64, len, &packed);
+    assert(ok);
+    (void)ok;
+    unpack(packed);
 }
 
 std::vector<proto::Future>
 State::init_execution_plan()
+{
+    Deadline unlimited;
+    return init_execution_plan(&unlimited);
+}
+
+std::vector<proto::Future>
+State::init_execution_plan(Deadline* deadline)
 {
     std::vector<proto::Future> res;
     std::vector<Target> targs;
-    setup_execution_plan(this, &res, &targs);
+    setup_execution_plan(this, &res, &targs, deadline);
 
     header->targets = targs.size();
-    update_pointers();
-    data.resize(sentinel - data.data());
+    header->futures = res.size();
+    // within the capacity init reserved, the buffer stays where it is
+    data.resize(layout_of(*header).size);
     update_pointers();
     for (size_t idx = 0; idx < targs.size(); ++idx) {
         Target*t = &targets[idx];
         *t = targs[idx];
     }
+    target_paths.assign(targs.size(), TargetPath{0, 0, 0});
+    for (size_t idx = 0; idx < res.size(); ++idx) {
+        uint32_t mine_id = 0;
+        while (mines[mine_id].site_id != static_cast<uint32_t>(res[idx].source)) ++mine_id;
+        bets[idx] = Bet{mine_id, static_cast<uint32_t>(res[idx].target)};
+        // the server knows the sites by its own ids
+        res[idx] = proto::Future(external_id(res[idx].source), external_id(res[idx].target));
+    }
 
 
     return res;
@@ -282,60 +527,533 @@ void
 State::update_pointers()
 {
     header = reinterpret_cast<Header*>(data.data());
+    Layout l = layout_of(*header);
+    owner_bytes = l.owner_bytes;
+
+    nodes = reinterpret_cast<Node*>(data.data() + l.nodes);
+    edge_refs = reinterpret_cast<EdgeRef*>(data.data() + l.edge_refs);
+    edges = reinterpret_cast<Edge*>(data.data() + l.edges);
+    site_ids = reinterpret_cast<uint32_t*>(data.data() + l.site_ids);
+    mines = reinterpret_cast<Mine*>(data.data() + l.mines);
+    distances = reinterpret_cast<uint16_t*>(data.data() + l.distances);
+    components = reinterpret_cast<uint32_t*>(data.data() + l.components);
+    frontier = reinterpret_cast<uint32_t*>(data.data() + l.frontier);
+    pass_bits = reinterpret_cast<uint64_t*>(data.data() + l.bits);
+    option_bits = pass_bits + (header->edges + 63) / 64;
+    claim_owners = data.data() + l.owners;
+    option_owners = data.data() + l.option_owners;
+    bets = reinterpret_cast<Bet*>(data.data() + l.bets);
+    targets = reinterpret_cast<Target*>(data.data() + l.targets);
+}
+
+void
+State::build_adjacency()
+{
+    // counting sort of edge ends by node, edges of a node stay in id order.
+    // Edges being in canonical order, that sorts each node's refs by
+    // neighbor: rivers from lower nodes first, then those to higher ones.
+    // find_edge relies on it.
+    for (uint32_t idx = 0; idx < header->nodes; ++idx) {
+        nodes[idx].first_edge_ref = 0;
+        nodes[idx].is_mine = 0;
+    }
+    for (uint32_t idx = 0; idx < header->edges; ++idx) {
+        nodes[edges[idx].source].first_edge_ref++;
+        nodes[edges[idx].target].first_edge_ref++;
+    }
+    assert(nodes[header->nodes - 1].first_edge_ref == 0);
+    for (uint32_t idx = 0, edge_iref = 0; idx < header->nodes; ++idx) {
+        uint32_t degree = nodes[idx].first_edge_ref;
+        nodes[idx].first_edge_ref = edge_iref;
+        edge_iref += degree;
+    }
+    // fill, advancing first_edge_ref of each node to its end
+    for (uint32_t idx = 0; idx < header->edges; ++idx) {
+        edge_refs[nodes[edges[idx].source].first_edge_ref++] = EdgeRef{edges[idx].target, idx};
+        edge_refs[nodes[edges[idx].target].first_edge_ref++] = EdgeRef{edges[idx].source, idx};
+    }
+    // and shift back: end of a node is start of the next one
+    for (uint32_t idx = header->nodes - 1; idx > 0; --idx) {
+        nodes[idx].first_edge_ref = nodes[idx - 1].first_edge_ref;
+    }
+    nodes[0].first_edge_ref = 0;
+    for (uint32_t idx = 0; idx + 1 < header->nodes; ++idx) {
+        for (uint32_t ref = nodes[idx].first_edge_ref + 1; ref < nodes[idx + 1].first_edge_ref; ++ref) {
+            assert(edge_refs[ref - 1].neighbor <= edge_refs[ref].neighbor);
+        }
+    }
+}
+
+void
+State::pack(std::vector<char>* out) const
+{
+    // Header | body, body is Mine[] | Target[] | Bet[] | topology | flag
+    // bitplanes | owners | target paths | distance rows if Header::distances,
+    // LZ compressed when Header::format says so
+    std::vector<char> body;
+    body.reserve(sizeof(Mine) * header->mines + sizeof(Target) * header->targets
+                 + sizeof(Bet) * header->futures + header->nodes + 5 * header->edges
+                 + kEdgeFlags * (header->edges / 8 + 1) + (distances_ready ? dist_entries() / 4 : 0));
+    compress::ByteWriter w(&body);
+    w.put(mines, sizeof(Mine) * header->mines);
+    w.put(targets, sizeof(Target) * header->targets);
+    w.put(bets, sizeof(Bet) * header->futures);
+
+    // rivers are sorted by (source, target), source < target: for each node
+    // write the number of rivers it is a source of and the target gaps
+    for (uint32_t node = 0, idx = 0; node < header->nodes - 1; ++node) {
+        uint32_t end = idx;
+        while (end < header->edges && edges[end].source == node) ++end;
+        w.varint(end - idx);
+        uint32_t prev = node;
+        for (; idx < end; ++idx) {
+            w.varint(edges[idx].target - prev);
+            prev = edges[idx].target;
+        }
+    }
+    // nodes are in BFS order, neighbors' ids tend to be close
+    for (uint32_t node = 0, prev = 0; node < header->nodes - 1; ++node) {
+        int32_t delta = static_cast<int32_t>(site_ids[node] - prev);
+        w.varint(static_cast<uint32_t>(delta) << 1 ^ static_cast<uint32_t>(delta >> 31));
+        prev = site_ids[node];
+    }
+
+    std::vector<uint64_t> plane((header->edges + 63) / 64);
+    for (int flag = 0; flag < kEdgeFlags; ++flag) {
+        std::fill(plane.begin(), plane.end(), 0);
+        for (uint32_t idx = 0; idx < header->edges; ++idx) {
+            plane[idx / 64] |= static_cast<uint64_t>(edge_flag(edges[idx], flag)) << (idx % 64);
+        }
+        compress::write_bitplane(&w, plane, header->edges);
+    }
+    // the flags tell which rivers have an owner, free ones cost nothing
+    for (uint32_t idx = 0; idx < header->edges; ++idx) {
+        if (edges[idx].is_claimed()) w.put(claim_owners + idx * owner_bytes, owner_bytes);
+    }
+    for (uint32_t idx = 0; idx < header->edges; ++idx) {
+        if (edges[idx].option) w.put(option_owners + idx * owner_bytes, owner_bytes);
+    }
+    // paths of reached targets are of no more use
+    for (uint32_t idx = 0; idx < header->targets; ++idx) {
+        PathRef p = target_path(idx);
+        if (targets[idx].is_reached()) {
+            w.varint(0);
+            continue;
+        }
+        w.varint(p.length * 2 + p.broken);
+        for (uint32_t i = 0; i < p.length; ++i) w.varint(p.edges[i]);
+    }
+    // neighbors are at most a river apart from any mine: each entry is
+    // coded in two bits as the difference to its node's lowest numbered
+    // neighbor, only the nodes that come before all of theirs, the first of
+    // each part of the map in BFS order, are written in full
+    if (distances_ready) {
+        std::vector<uint32_t> base, roots;
+        dist_bases(&base, &roots);
+        std::vector<uint8_t> codes;
+        for (uint32_t m = 0; m < header->mines; ++m) {
+            const uint16_t* row = distances + static_cast<size_t>(m) * header->nodes;
+            for (uint32_t node: roots) w.varint(row[node]);
+            codes.assign((header->nodes + 3) / 4, 0);
+            for (uint32_t node = 0; node < header->nodes; ++node) {
+                uint16_t code = row[node] - row[base[node]] + 1;
+                assert(code <= 2);
+                codes[node / 4] |= code << (node % 4 * 2);
+            }
+            w.put(codes.data(), codes.size());
+        }
+    }
+
+    Header h = *header;
+    h.format = FORMAT_PACKED;
+    h.distances = distances_ready;
+    std::vector<char> compressed;
+    if (body.size() >= kCompressMin) {
+        compress::lz_compress(body.data(), body.size(), &compressed);
+        if (compressed.size() < body.size()) {
+            h.format = FORMAT_COMPRESSED;
+            body.swap(compressed);
+        }
+    }
+    out->clear();
+    out->reserve(sizeof(Header) + body.size());
+    compress::ByteWriter hw(out);
+    hw.put(&h, sizeof(Header));
+    hw.put(body.data(), body.size());
+}
+
+void
+State::unpack(const std::vector<char>& in)
+{
+    assert(in.size() >= sizeof(Header));
+    Header h;
+    memcpy(&h, in.data(), sizeof(Header));
+    data.resize(layout_of(h).size);
+    memcpy(data.data(), &h, sizeof(Header));
+    update_pointers();
+
+    std::vector<char> body;
+    const char* body_begin = in.data() + sizeof(Header);
+    size_t body_size = in.size() - sizeof(Header);
+    if (header->format == FORMAT_COMPRESSED) {
+        bool ok = compress::lz_decompress(body_begin, body_size, &body);
+        assert(ok);
+        (void)ok;
+        body_begin = body.data();
+        body_size = body.size();
+    } else {
+        assert(header->format == FORMAT_PACKED);
+    }
+
+    compress::ByteReader r(body_begin, body_size);
+    r.get(mines, sizeof(Mine) * header->mines);
+    r.get(targets, sizeof(Target) * header->targets);
+    r.get(bets, sizeof(Bet) * header->futures);
+
+    for (uint32_t node = 0, idx = 0; node < header->nodes - 1; ++node) {
+        uint32_t count = r.varint();
+        uint32_t prev = node;
+        for (uint32_t i = 0; i < count; ++i, ++idx) {
+            assert(idx < header->edges);
+            prev += r.varint();
+            edges[idx] = Edge(proto::River{static_cast<int>(node), static_cast<int>(prev)});
+        }
+    }
+    for (uint32_t node = 0, prev = 0; node < header->nodes - 1; ++node) {
+        uint32_t v = r.varint();
+        prev += (v >> 1) ^ (0u - (v & 1));
+        site_ids[node] = prev;
+    }
+    site_ids[header->nodes - 1] = UNDEFINED;
+    build_adjacency();
+
+    std::vector<uint64_t> plane;
+    for (int flag = 0; flag < kEdgeFlags; ++flag) {
+        compress::read_bitplane(&r, &plane, header->edges);
+        for (uint32_t idx = 0; idx < header->edges; ++idx) {
+            set_edge_flag(&edges[idx], flag, (plane[idx / 64] >> (idx % 64)) & 1);
+        }
+    }
+    for (uint32_t idx = 0; idx < header->edges; ++idx) {
+        if (edges[idx].is_claimed()) r.get(claim_owners + idx * owner_bytes, owner_bytes);
+    }
+    for (uint32_t idx = 0; idx < header->edges; ++idx) {
+        if (edges[idx].option) r.get(option_owners + idx * owner_bytes, owner_bytes);
+    }
+    target_paths.resize(header->targets);
+    path_edges.clear();
+    on_path.assign((header->edges + 63) / 64, 0);
+    for (uint32_t idx = 0; idx < header->targets; ++idx) {
+        uint32_t v = r.varint();
+        TargetPath* p = &target_paths[idx];
+        p->begin = path_edges.size();
+        p->length = v / 2;
+        p->broken = v % 2;
+        for (uint32_t i = 0; i < p->length; ++i) {
+            uint32_t edge_id = r.varint();
+            assert(edge_id < header->edges);
+            path_edges.push_back(edge_id);
+            on_path[edge_id / 64] |= 1ull << (edge_id % 64);
+        }
+    }
+    if (header->distances) {
+        std::vector<uint32_t> base, roots;
+        dist_bases(&base, &roots);
+        std::vector<uint8_t> codes((header->nodes + 3) / 4);
+        for (uint32_t m = 0; m < header->mines; ++m) {
+            uint16_t* row = distances + static_cast<size_t>(m) * header->nodes;
+            for (uint32_t node: roots) row[node] = r.varint();
+            r.get(codes.data(), codes.size());
+            // a base comes before its node, roots are their own and step 0
+            for (uint32_t node = 0; node < header->nodes; ++node) {
+                row[node] = row[base[node]] + ((codes[node / 4] >> (node % 4 * 2)) & 3) - 1;
+            }
+        }
+        distances_ready = true;
+    }
+    assert(r.done());
+    build_components();
+
+    for (uint32_t idx = 0; idx < header->mines; ++idx) {
+        nodes[mines[idx].site_id].is_mine = 1;
+    }
+}
+
+void
+State::build_components()
+{
+    for (uint32_t idx = 0; idx < header->nodes; ++idx) {
+        components[idx] = idx;
+        frontier[idx] = 0;
+    }
+    for (uint32_t idx = 0; idx < header->edges; ++idx) {
+        if (edges[idx].is_unclaimed()) {
+            frontier[edges[idx].source]++;
+            frontier[edges[idx].target]++;
+        }
+    }
+    for (uint32_t idx = 0; idx < header->edges; ++idx) {
+        if (edges[idx].claimed_by_me()) join(edges[idx].source, edges[idx].target);
+    }
+    for (uint32_t idx = 0; idx < header->edges; ++idx) update_edge_bits(idx);
+}
+
+void
+State::update_edge_bits(uint32_t edge_id)
+{
+    const Edge& e = edges[edge_id];
+    uint64_t bit = 1ull << (edge_id % 64);
+    uint64_t* pass = &pass_bits[edge_id / 64];
+    uint64_t* option = &option_bits[edge_id / 64];
+    *pass = e.can_pass() ? *pass | bit : *pass & ~bit;
+    *option = !e.can_pass() && e.can_exec_opt() ? *option | bit : *option & ~bit;
+}
+
+uint32_t
+State::component(uint32_t node)
+{
+    return unionfind::find(components, node);
+}
+
+void
+State::join(uint32_t a, uint32_t b)
+{
+    a = component(a);
+    b = component(b);
+    if (a == b) return;
+    // hang the smaller frontier below, a rough stand-in for component size
+    if (frontier[a] > frontier[b]) std::swap(a, b);
+    components[a] = b;
+    frontier[b] += frontier[a];
+}
+
+void
+State::set_target_path(uint32_t t_id, const std::vector<uint32_t>& edge_ids)
+{
+    TargetPath* p = &target_paths[t_id];
+    // in place when the new path fits, paths mostly get shorter
+    if (edge_ids.size() > p->length) {
+        p->begin = path_edges.size();
+        path_edges.resize(path_edges.size() + edge_ids.size());
+    }
+    std::copy(edge_ids.begin(), edge_ids.end(), path_edges.begin() + p->begin);
+    p->length = edge_ids.size();
+    p->broken = 0;
+    for (uint32_t edge_id: edge_ids) on_path[edge_id / 64] |= 1ull << (edge_id % 64);
+
+    size_t live = 0;
+    for (const TargetPath& t: target_paths) live += t.length;
+    if (path_edges.size() > 2 * live + 1024) compact_paths();
+}
 
-    size_t nodes_offset = sizeof(Header);
-    size_t edge_refs_offset = nodes_offset + sizeof(Node) * header->nodes;
-    size_t edges_offset = edge_refs_offset + sizeof(EdgeRef) * header->edges * 2;
-    size_t mines_offset = edges_offset + sizeof(Edge) * header->edges;
-    size_t targets_offset = mines_offset + sizeof(Mine) * header->mines;
+void
+State::compact_paths()
+{
+    std::vector<uint32_t> pool;
+    pool.reserve(path_edges.size() / 2);
+    std::fill(on_path.begin(), on_path.end(), 0);
+    for (TargetPath& p: target_paths) {
+        uint32_t begin = pool.size();
+        for (uint32_t i = 0; i < p.length; ++i) {
+            uint32_t edge_id = path_edges[p.begin + i];
+            pool.push_back(edge_id);
+            on_path[edge_id / 64] |= 1ull << (edge_id % 64);
+        }
+        p.begin = begin;
+    }
+    path_edges.swap(pool);
+}
 
-    sentinel = data.data() + targets_offset + sizeof(Target) * header->targets;
+void
+State::break_paths(uint32_t edge_id)
+{
+    // the bits are only ever cleared by compaction, a stale one costs a scan
+    if (((on_path[edge_id / 64] >> (edge_id % 64)) & 1) == 0) return;
+    for (TargetPath& p: target_paths) {
+        if (p.broken) continue;
+        const uint32_t* begin = path_edges.data() + p.begin;
+        if (std::find(begin, begin + p.length, edge_id) != begin + p.length) p.broken = 1;
+    }
+}
 
-    nodes = reinterpret_cast<Node*>(data.data() + nodes_offset);
-    edge_refs = reinterpret_cast<EdgeRef*>(data.data() + edge_refs_offset);
-    edges = reinterpret_cast<Edge*>(data.data() + edges_offset);
-    mines = reinterpret_cast<Mine*>(data.data() + mines_offset);
-    targets = reinterpret_cast<Target*>(data.data() + targets_offset);
+Scores*
+State::scores()
+{
+    Deadline unlimited;
+    if (!build_distances(&unlimited)) return nullptr;
+    if (!score_keeper) score_keeper.reset(new Scores(this));
+    return score_keeper.get();
+}
+
+size_t
+State::dist_entries() const
+{
+    return dist_entries_of(*header);
+}
+
+void
+State::dist_bases(std::vector<uint32_t>* base, std::vector<uint32_t>* roots) const
+{
+    base->resize(header->nodes);
+    roots->clear();
+    for (uint32_t node = 0; node < header->nodes; ++node) {
+        // the adjacency is sorted by neighbor, the first is the lowest
+        uint32_t ref = nodes[node].first_edge_ref;
+        bool first = node + 1 == header->nodes || ref == nodes[node + 1].first_edge_ref
+            || edge_refs[ref].neighbor > node;
+        (*base)[node] = first ? node : edge_refs[ref].neighbor;
+        if (first) roots->push_back(node);
+    }
+}
+
+bool
+State::build_distances(Deadline* deadline)
+{
+    if (distances_ready) return true;
+    if (!has_distances() || deadline->expired()) return false;
+    uint32_t num_nodes = header->nodes;
+    std::atomic<bool> gave_up(false);
+    thread_pool().parallel_for(header->mines, [&](size_t m) {
+        Deadline local = deadline->for_thread();
+        if (gave_up) return;
+        // the row itself marks visited nodes
+        uint16_t* dist = distances + m * num_nodes;
+        std::fill(dist, dist + num_nodes, DIST_UNREACHABLE);
+        std::vector<uint32_t> queue;
+        queue.reserve(1024);
+        uint32_t root = mines[m].site_id;
+        dist[root] = 0;
+        queue.push_back(root);
+        for (size_t head = 0; head < queue.size(); ++head) {
+            if (local.poll()) {
+                gave_up = true;
+                return;
+            }
+            uint32_t node = queue[head];
+            uint16_t d = dist[node] >= DIST_MAX ? DIST_MAX : dist[node] + 1;
+            auto iter = get_edges_iter(node);
+            for (auto i = iter.first; i < iter.second; ++i) {
+                uint32_t t = neighbor_by_ref(i);
+                if (dist[t] != DIST_UNREACHABLE) continue;
+                dist[t] = d;
+                queue.push_back(t);
+            }
+        }
+    });
+    distances_ready = !gave_up;
+    return distances_ready;
 }
 
 std::string
 State::serialize() const
 {
     std::string result;
-    Base64::Encode(data, &result);
+    serialize(&result);
     return result;
 }
 
+void
+State::serialize(std::string* out) const
+{
+    std::vector<char> packed;
+    pack(&packed);
+    // room for whatever message wraps the state
+    out->reserve(out->size() + base64::encoded_length(packed.size()) + 16);
+    base64::append(packed.data(), packed.size(), out);
+}
+
 
 void
 State::update(const std::vector< proto::Move >& moves)
 {
+    // a splurge of n rivers spends n - 1 banked passes, claims and options
+    // leave the credit alone
+    auto spend = [&](uint32_t rivers) {
+        uint32_t* credit = &get_header()->credit;
+        *credit -= std::min(*credit, rivers - 1);
+    };
+    uint32_t my_claims = 0;
     for(const auto& m: moves) {
+        bool mine = m.punter == whoami();
         if (m.move_type == proto::CLAIM || m.move_type == proto::OPTION) {
-            Edge* e = find_edge(m.source, m.target);
-            assert(e != nullptr);
+            claim_river(m.punter, internal_id(m.source), internal_id(m.target));
+        } else if (m.move_type == proto::SPLURGE) {
+            // the server sends these as claims, our own may come this way
+            for (size_t idx = 1; idx < m.route.size(); ++idx) {
+                claim_river(m.punter, internal_id(m.route[idx - 1]), internal_id(m.route[idx]));
+            }
+        }
+        if (!mine) continue;
+        // the first message has a pass for everybody who did not move yet
+        if (m.move_type == proto::PASS) {
+            if (get_header()->move_seq > 0 && get_header()->has_splurges) get_header()->credit++;
+        } else if (m.move_type == proto::CLAIM) {
+            ++my_claims;
+        } else if (m.move_type == proto::SPLURGE && m.route.size() > 1) {
+            spend(m.route.size() - 1);
+        }
+    }
+    // a message has one move of ours, more claims are a splurge sent as such
+    if (my_claims > 1) spend(my_claims);
+    get_header()->move_seq++;
+}
+
+uint32_t
+State::internal_id(uint32_t site)
+{
+    if (node_of_site.empty()) node_of_site.build(site_ids, header->nodes - 1);
+    uint32_t node = UNDEFINED;
+    node_of_site.find(site, &node);
+    return node;
+}
 
-            bool claimed_by_me = m.punter == whoami();
-            std::string punter = (claimed_by_me ? "me" : std::to_string(m.punter));
-            if (e->is_unclaimed()) {
+proto::Move
+State::splurge(const std::vector<uint32_t>& route)
+{
+    std::vector<int> sites;
+    sites.reserve(route.size());
+    for (uint32_t node: route) sites.push_back(external_id(node));
+    return proto::Move::splurge(whoami(), sites);
+}
+
+void
+State::claim_river(int punter, uint32_t source, uint32_t target)
+{
+    Edge* e = find_edge(source, target);
+    assert(e != nullptr);
+
+    bool claimed_by_me = punter == whoami();
+    bool could_pass = e->can_pass();
+#ifdef DEBUG
+    std::string who = (claimed_by_me ? "me" : std::to_string(punter));
+#endif
+    if (e->is_unclaimed()) {
 #ifdef DEBUG
-                std::cerr << "Edge claimed: " << m.source << "->" << m.target << ", by: "
-                          <<  punter << std::endl;
+        std::cerr << "Edge claimed: " << source << "->" << target << ", by: "
+                  <<  who << std::endl;
 #endif
-                e->claimed = 1;
-                e->me = claimed_by_me;
-            } else {
+        e->claimed = 1;
+        e->me = claimed_by_me;
+        store_owner(claim_owners, edge_id(e), punter);
+        frontier[component(e->source)]--;
+        frontier[component(e->target)]--;
+        if (claimed_by_me) join(e->source, e->target);
+    } else {
 #ifdef DEBUG
-                std::cerr << "Option executed: " << m.source << "->" << m.target << ", by: "
-                          <<  punter << std::endl;
+        std::cerr << "Option executed: " << source << "->" << target << ", by: "
+                  <<  who << std::endl;
 #endif
 
-                assert(e->can_exec_opt());
-                e->option = 1;
-                get_header()->options_avail--;
-                if (e->me == 0) e->me = claimed_by_me;
-            }
-        }
+        assert(e->can_exec_opt());
+        e->option = 1;
+        store_owner(option_owners, edge_id(e), punter);
+        get_header()->options_avail--;
+        if (e->me == 0) e->me = claimed_by_me;
+        if (claimed_by_me) join(e->source, e->target);
     }
-    get_header()->move_seq++;
+    update_edge_bits(edge_id(e));
+    // an option on one of our rivers leaves it to us as well, paths over it
+    // stay good
+    if (could_pass && !e->can_pass()) break_paths(edge_id(e));
+    if (score_keeper) score_keeper->add_river(punter, e->source, e->target);
 }
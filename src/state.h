@@ -1,13 +1,28 @@
 #pragma once
 
+#include <algorithm>
+#include <memory>
 #include <string>
 #include <stdint.h>
 #include <cassert>
+#include "deadline.h"
+#include "idmap.h"
 #include "protocol.h"
+#include "search.h"
 
 
 #define UNDEFINED 0x3fffffff
 
+#define DIST_UNREACHABLE 0xffff
+#define DIST_MAX 0xfffe          // longer distances saturate here
+
+#define NO_OWNER 0xffffffff      // river nobody claimed / no option executed
+
+#define SCAN_DEGREE 16           // find_edge scans shorter adjacency lists
+
+/** encoding of the serialized state after the Header */
+enum StateFormat { FORMAT_PACKED = 1, FORMAT_COMPRESSED = 2 };
+
 
 struct Header {
     uint32_t punters_sz; // total number of punters
@@ -17,9 +32,13 @@ struct Header {
     uint32_t edges;      // total number of rivers
     uint32_t mines;      // total number of mines
     uint32_t targets;
+    uint32_t futures;    // our bets, see Bet
     uint32_t options_avail;
+    uint32_t credit;     // our passes banked for a splurge
     uint8_t  has_futures;
     uint8_t  has_splurges;
+    uint8_t  format;     // StateFormat, only meaningful in serialized form
+    uint8_t  distances;  // 1: the distance table follows, serialized form only
 };
 
 
@@ -31,10 +50,14 @@ struct Node {
     uint32_t is_mine : 1;
 };
 
+/** adjacency entry, the neighbor inline so traversals skip the Edge */
 struct EdgeRef {
+    uint32_t neighbor;
     uint32_t edge_id;
 };
 
+static_assert(sizeof(EdgeRef) == 8, "8 bytes expected");
+
 struct Edge {
     Edge(const proto::River& r): source(r.source), claimed(0), option(0),
                                  target(r.target), me(0), breadcrumb(0) {}
@@ -63,18 +86,45 @@ struct Target {
     bool is_reached() const {return reached != 0; }
 };
 
+/** where the cached path of a target sits in the path pool */
+struct TargetPath {
+    uint32_t begin;
+    uint32_t length:31;
+    uint32_t broken:1;    // somebody else took a river on it since
+};
+
+/** cached path of a target: edge ids in order from its source */
+struct PathRef {
+    const uint32_t* edges;
+    uint32_t length;
+    bool broken;
+};
+
 static_assert(sizeof(Edge) == 8, "8 bytes expected");
 
 struct Mine {
     uint32_t site_id;
 };
 
+/** future we bet on: site_id connected to mine #mine_id by the end of the game */
+struct Bet {
+    uint32_t mine_id;
+    uint32_t site_id;
+};
+
+class Scores;
+
 class State {
 public:
     State(proto::Setup& setup);
+    State(const proto::SetupView& setup);
     State(const std::string& base64);
+    State(const char* base64, size_t len);
+    ~State();
 
     std::string serialize() const;
+    /** append base64 state to out */
+    void serialize(std::string* out) const;
 
     void update(const std::vector< proto::Move >& moves);
 
@@ -82,6 +132,7 @@ public:
     uint32_t num_edges() { return get_header()->edges; }
     uint32_t num_mines() { return get_header()->mines; }
     uint32_t num_targets() { return get_header()->targets; }
+    uint32_t num_bets() { return get_header()->futures; }
 
     Header* get_header() { return header; }
     Node* get_nodes() { return nodes; }
@@ -94,21 +145,147 @@ public:
     int moves_left() { return moves_total() - get_header()->move_seq;   }
 
     Edge* get_edge_by_ref(uint32_t edge_ref) { return get_edge(edge_refs[edge_ref].edge_id); }
+    uint32_t edge_id_by_ref(uint32_t edge_ref) const { return edge_refs[edge_ref].edge_id; }
+    /** site at the other end of the river */
+    uint32_t neighbor_by_ref(uint32_t edge_ref) const { return edge_refs[edge_ref].neighbor; }
+
+    /** Edge::can_pass() from a dense bitset, without touching the Edge */
+    bool can_pass(uint32_t edge_id) const { return (pass_bits[edge_id / 64] >> (edge_id % 64)) & 1; }
+    /** claimed by somebody else and open to an option */
+    bool can_buy_option(uint32_t edge_id) const { return (option_bits[edge_id / 64] >> (edge_id % 64)) & 1; }
 
     Node* get_node(uint32_t node_id) { return &nodes[node_id]; }
     Edge* get_edge(uint32_t edge_id) { return &edges[edge_id]; }
     Mine* get_mine(uint32_t mine_id) { return &mines[mine_id]; }
     Target* get_target(uint32_t t_id) { return &targets[t_id]; }
 
+    /** empty until set_target_path(), flagged broken by update() */
+    PathRef target_path(uint32_t t_id) const {
+        const TargetPath& p = target_paths[t_id];
+        return PathRef{path_edges.data() + p.begin, p.length, p.broken != 0};
+    }
+    void set_target_path(uint32_t t_id, const std::vector<uint32_t>& edge_ids);
+    Bet* get_bet(uint32_t bet_id) { return &bets[bet_id]; }
+
+    uint32_t edge_id(const Edge* e) const { return e - edges; }
+
+    /** punter who claimed the river, NO_OWNER if it is free */
+    uint32_t claim_owner(uint32_t edge_id) const { return load_owner(claim_owners, edge_id); }
+    /** punter who executed the option on the river, NO_OWNER if none did */
+    uint32_t option_owner(uint32_t edge_id) const { return load_owner(option_owners, edge_id); }
+
+    /** punter can use the river: claimed it or holds the option */
+    bool owned_by(uint32_t edge_id, uint32_t punter) const {
+        return claim_owner(edge_id) == punter || option_owner(edge_id) == punter;
+    }
+
+    /**
+     * f(edge_id, punter) for every river somebody claimed, with its claim
+     * owner, then again with the option owner if somebody bought one: all
+     * punters' rivers in a single pass.
+     */
+    template<typename F>
+    void for_each_owned_river(F f) const {
+        for (uint32_t idx = 0; idx < header->edges; ++idx) {
+            if (edges[idx].is_unclaimed()) continue;
+            f(idx, claim_owner(idx));
+            if (edges[idx].option) f(idx, option_owner(idx));
+        }
+    }
+
+    /** number of rivers punter can use */
+    uint32_t rivers_of(uint32_t punter) const {
+        uint32_t count = 0;
+        for_each_owned_river([&](uint32_t, uint32_t owner) { count += owner == punter; });
+        return count;
+    }
+
     bool is_mine(uint32_t node_id) { return get_node(node_id)->is_mine != 0; }
 
-    proto::Move claim_edge(uint32_t source, uint32_t target) { return proto::Move::claim(whoami(), source, target); }
-    proto::Move execute_option(uint32_t source, uint32_t target) {
-        assert(get_header()->options_avail > 0);
-        return proto::Move::option(whoami(), source, target);
+    /** false when the map is too large for a distance table */
+    bool has_distances() const { return dist_entries() > 0; }
+
+    /**
+     * Fill the distance table unless it is there already: one BFS per mine.
+     * Setup does it, the table is serialized from then on and a loaded
+     * state has it right away. False if the map has no table or the
+     * deadline hit first.
+     */
+    bool build_distances(Deadline* deadline);
+
+    /**
+     * Rivers on the shortest path from mine #mine_idx to node, claims are
+     * ignored. Needs build_distances().
+     */
+    uint16_t mine_distance(uint32_t mine_idx, uint32_t node) {
+        return mine_distances(mine_idx)[node];
+    }
+
+    /** distances from mine #mine_idx, indexed by node */
+    const uint16_t* mine_distances(uint32_t mine_idx) {
+        assert(distances_ready);
+        return distances + static_cast<size_t>(mine_idx) * header->nodes;
+    }
+
+    /** representative of the component of node over rivers I can use */
+    uint32_t component(uint32_t node);
+
+    bool connected(uint32_t a, uint32_t b) { return component(a) == component(b); }
+
+    /**
+     * Unclaimed rivers touching the component of node, counted once per
+     * end in the component.
+     */
+    uint32_t frontier_size(uint32_t node) { return frontier[component(node)]; }
+
+    /**
+     * Score of every punter as if the game ended now, kept up to date by
+     * update() once created. nullptr on maps too large for a distance
+     * table, naive_score() still works there.
+     */
+    Scores* scores();
+
+    /**
+     * Scratch space for a search, reset for the current graph. Searches
+     * running in parallel take the one of their thread_pool() slot.
+     */
+    SearchSpace* new_search(unsigned slot = 0) {
+        assert(2 * slot < searches.size());
+        searches[2 * slot].reset(header->nodes);
+        return &searches[2 * slot];
     }
 
+    /** two at once, for a search from both ends */
+    std::pair<SearchSpace*, SearchSpace*> new_search_pair(unsigned slot = 0) {
+        assert(2 * slot + 1 < searches.size());
+        searches[2 * slot].reset(header->nodes);
+        searches[2 * slot + 1].reset(header->nodes);
+        return std::make_pair(&searches[2 * slot], &searches[2 * slot + 1]);
+    }
+
+    /**
+     * Sites are renumbered at setup, the server's ids are only seen in
+     * messages: moves are made here and translated back in update().
+     */
+    uint32_t external_id(uint32_t node) const { return site_ids[node]; }
+    /** node of the server's site id, UNDEFINED if there is none */
+    uint32_t internal_id(uint32_t site);
+
+    proto::Move claim_edge(uint32_t source, uint32_t target) { return claim_edge(source, target, whoami()); }
+    proto::Move claim_edge(uint32_t source, uint32_t target, int punter) {
+        return proto::Move::claim(punter, external_id(source), external_id(target));
+    }
+    proto::Move execute_option(uint32_t source, uint32_t target) { return execute_option(source, target, whoami()); }
+    proto::Move execute_option(uint32_t source, uint32_t target, int punter) {
+        assert(punter != whoami() || get_header()->options_avail > 0);
+        return proto::Move::option(punter, external_id(source), external_id(target));
+    }
+    /** claim the rivers along route, a list of nodes */
+    proto::Move splurge(const std::vector<uint32_t>& route);
+
     std::vector<proto::Future> init_execution_plan();
+    /** plan as much as fits before the deadline */
+    std::vector<proto::Future> init_execution_plan(Deadline* deadline);
 
 //    bool claimed_by_me(Edge* e) { return (int)e->claimed_by == whoami(); }
 
@@ -122,17 +299,33 @@ public:
         return std::make_pair(from_ref, to_ref);
     }
 
+    /**
+     * River between source and target, nullptr if there is none. Looks
+     * from the end with fewer rivers, the adjacency being sorted by
+     * neighbor: a short scan for small degrees, binary search for hubs.
+     */
     Edge*
     find_edge(uint32_t source, uint32_t target)
     {
         assert(source < header->nodes - 1);
         assert(target < header->nodes - 1);
         auto edges_iter = get_edges_iter(source);
+        auto other_iter = get_edges_iter(target);
+        if (other_iter.second - other_iter.first < edges_iter.second - edges_iter.first) {
+            edges_iter = other_iter;
+            target = source;
+        }
 
-        for(uint32_t ref = edges_iter.first; ref < edges_iter.second; ++ref) {
-            Edge* e = get_edge_by_ref(ref);
-            if (e->target == target || e->source == target) return e;
+        uint32_t ref = edges_iter.first, end = edges_iter.second;
+        if (end - ref > SCAN_DEGREE) {
+            const EdgeRef* it = std::lower_bound(
+                edge_refs + ref, edge_refs + end, target,
+                [](const EdgeRef& r, uint32_t n) { return r.neighbor < n; });
+            ref = it - edge_refs;
+        } else {
+            while (ref < end && edge_refs[ref].neighbor < target) ++ref;
         }
+        if (ref < end && edge_refs[ref].neighbor == target) return get_edge_by_ref(ref);
         return nullptr;
     }
 
@@ -143,10 +336,87 @@ private:
     Node* nodes;
     EdgeRef* edge_refs;
     Edge* edges;
+    uint32_t* site_ids;   // per node, the server's id
     Mine* mines;
+    uint16_t* distances;  // [mine][node], static, once built
+    uint32_t* components; // union-find parent per node over my rivers, rebuilt
+    uint32_t* frontier;   // per component root, see frontier_size(), rebuilt
+    uint64_t* pass_bits;  // per edge Edge::can_pass(), rebuilt
+    uint64_t* option_bits; // per edge, somebody else's with the option open, rebuilt
+    char* claim_owners;   // per edge punter + 1, 0 for nobody, owner_bytes wide
+    char* option_owners;  // same for options
+    Bet* bets;
     Target* targets;
 
-    char* sentinel;
+    uint32_t owner_bytes; // 1, or 2 when there are too many punters for a byte
 
+    IdMap node_of_site; // inverse of site_ids, built on first use
+
+    // cached target paths live outside data, which must not move during a
+    // turn; they are serialized all the same
+    std::vector<TargetPath> target_paths; // per target
+    std::vector<uint32_t> path_edges;     // pool of edge ids
+    std::vector<uint64_t> on_path;        // edge bits, set for rivers on some path
+
+    std::vector<SearchSpace> searches; // two per pool slot
+    bool distances_ready = false;
+    std::unique_ptr<Scores> score_keeper;
+
+    /** point the sections into data, laid out for the header it starts with */
     void update_pointers();
+
+    /** river source-target, nodes, claimed or its option bought by punter */
+    void claim_river(int punter, uint32_t source, uint32_t target);
+
+    /** flag the paths using edge #edge_id as broken */
+    void break_paths(uint32_t edge_id);
+    /** drop unused space from the path pool */
+    void compact_paths();
+
+    uint32_t load_owner(const char* owners, uint32_t edge_id) const {
+        // punter + 1 is stored, so nobody wraps around to NO_OWNER
+        uint32_t v = owner_bytes == 1 ? static_cast<uint8_t>(owners[edge_id])
+                                      : reinterpret_cast<const uint16_t*>(owners)[edge_id];
+        return v - 1;
+    }
+
+    void store_owner(char* owners, uint32_t edge_id, uint32_t punter) {
+        if (owner_bytes == 1) {
+            owners[edge_id] = static_cast<char>(punter + 1);
+        } else {
+            reinterpret_cast<uint16_t*>(owners)[edge_id] = punter + 1;
+        }
+    }
+
+    /** union-find, frontier counts and edge bits from the Edge flags */
+    void build_components();
+    /** pass_bits and option_bits of edge #edge_id from its flags */
+    void update_edge_bits(uint32_t edge_id);
+    void join(uint32_t a, uint32_t b);
+
+    /** number of distance table entries, 0 if over budget */
+    size_t dist_entries() const;
+    /**
+     * Per node its lowest numbered neighbor when that comes before it, else
+     * the node itself, a root: what the distance table is serialized against.
+     */
+    void dist_bases(std::vector<uint32_t>* base, std::vector<uint32_t>* roots) const;
+
+    /** build from setup settings and a map providing for_each_site/for_each_river */
+    template<typename Settings, typename Map>
+    void init(const Settings& setup, std::vector<int> mine_sites, const Map& map);
+
+    /** rebuild Node and EdgeRef arrays (CSR) from the Edge array */
+    void build_adjacency();
+
+    /**
+     * Serialized form: Header, then mines, targets, bets, rivers as per-node
+     * varint gaps, site ids as varint deltas, edge flags as bitplanes, owners
+     * of claimed and optioned rivers, cached target paths and the distance
+     * table if built, as two bit steps between neighbors, optionally LZ
+     * compressed.
+     * Node and EdgeRef arrays are rebuilt.
+     */
+    void pack(std::vector<char>* out) const;
+    void unpack(const std::vector<char>& in);
 };
@@ -0,0 +1,34 @@
+#pragma once
+
+/**
+ * Union-find over a parent array indexed by node, roots being their own
+ * parent. Callers own the array and whatever they keep per root, and pick
+ * the root that stays on top when they care.
+ */
+namespace unionfind {
+
+/** root of the set of node, halving the path on the way */
+template<typename T>
+T
+find(T* parent, T node)
+{
+    while (parent[node] != node) {
+        parent[node] = parent[parent[node]];
+        node = parent[node];
+    }
+    return node;
+}
+
+/** hang the set of a below the root of b, false if they were one set */
+template<typename T>
+bool
+join(T* parent, T a, T b)
+{
+    a = find(parent, a);
+    b = find(parent, b);
+    if (a == b) return false;
+    parent[a] = b;
+    return true;
+}
+
+}
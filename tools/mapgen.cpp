@@ -0,0 +1,101 @@
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+
+/**
+ * Synthetic maps for scaling tests, written as the setup message the server
+ * would send, so that they go through the same parsing as real ones.
+ */
+
+namespace {
+
+void
+usage()
+{
+    std::cerr << "usage: mapgen <grid|geometric|scale-free|chain> [options]" << std::endl
+              << "  --sites N      number of sites (10000)" << std::endl
+              << "  --rivers N     rivers wanted, geometric and scale-free only (2 per site)" << std::endl
+              << "  --mines N      number of mines (4)" << std::endl
+              << "  --punters N    number of punters (2)" << std::endl
+              << "  --punter N     our punter id (0)" << std::endl
+              << "  --seed N       random seed (42)" << std::endl
+              << "  --futures, --splurges, --options  turn the setting on" << std::endl
+              << "  -o FILE        write to FILE instead of stdout" << std::endl;
+}
+
+}
+
+int
+main(int argc, char** argv)
+{
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+    std::string kind = argv[1];
+    int sites = 10000, mines = 4, punters = 2, punter = 0;
+    long rivers = -1;
+    uint32_t seed = 42;
+    bool futures = false, splurges = false, options = false;
+    const char* path = nullptr;
+    for (int i = 2; i < argc; ++i) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--sites") == 0 && has_value) sites = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--rivers") == 0 && has_value) rivers = atol(argv[++i]);
+        else if (strcmp(argv[i], "--mines") == 0 && has_value) mines = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--punters") == 0 && has_value) punters = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--punter") == 0 && has_value) punter = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && has_value) seed = strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--futures") == 0) futures = true;
+        else if (strcmp(argv[i], "--splurges") == 0) splurges = true;
+        else if (strcmp(argv[i], "--options") == 0) options = true;
+        else if (strcmp(argv[i], "-o") == 0 && has_value) path = argv[++i];
+        else {
+            usage();
+            return 1;
+        }
+    }
+    if (sites < 2 || punters < 1 || punter < 0 || punter >= punters) {
+        usage();
+        return 1;
+    }
+    if (rivers < 0) rivers = 2l * sites;
+
+    proto::Setup setup;
+    if (kind == "grid") {
+        int w = static_cast<int>(sqrt(sites));
+        setup = bench::grid_setup(w, sites / w, mines, punters, seed);
+    } else if (kind == "geometric") {
+        setup = bench::geometric_setup(sites, 2.0 * rivers / sites, mines, punters, seed);
+    } else if (kind == "scale-free") {
+        int links = static_cast<int>(std::lround(static_cast<double>(rivers) / sites));
+        setup = bench::scale_free_setup(sites, links, mines, punters, seed);
+    } else if (kind == "chain") {
+        setup = bench::chain_setup(sites, mines, punters, seed);
+    } else {
+        usage();
+        return 1;
+    }
+    setup.punter = punter;
+    setup.has_futures = futures;
+    setup.has_splurges = splurges;
+    setup.has_options = options;
+
+    std::string json = bench::setup_json(setup);
+    if (path != nullptr) {
+        std::ofstream out(path, std::ios::binary);
+        out.write(json.data(), json.size());
+        if (!out) {
+            std::cerr << "cannot write " << path << std::endl;
+            return 1;
+        }
+    } else {
+        std::cout.write(json.data(), json.size());
+    }
+    std::cerr << kind << ": " << setup.map.sites.size() << " sites, " << setup.map.rivers.size()
+              << " rivers, " << setup.map.mines.size() << " mines" << std::endl;
+    return 0;
+}